@@ -22,6 +22,8 @@
 #include "decsteps.h"
 #include "base64.h"
 
+#include "minmax.h"
+
 /* Table of characters coding the 64 values.  */
 char base64_value_to_char[64] =
 {
@@ -73,6 +75,64 @@ short base64_char_to_value[128] =
    The octets are divided into 6 bit chunks, which are then encoded into
    Base64 characters.  */
 
+/* Number of MIME lines prepared at once by block kernels.  */
+#define BLOCK_LINES 16
+
+/*-------------------------------------------------------------------------.
+| Encode all complete triplets from the in-memory input of SUBTASK, a few  |
+| lines at a time.  *COUNTER is the number of quadruplets already on the   |
+| current output line, it gets updated.  Any remaining one or two bytes    |
+| are left in the input for the byte path, which then produces padding.    |
+`-------------------------------------------------------------------------*/
+
+static void
+encode_base64_block (RECODE_SUBTASK subtask, int *counter)
+{
+  const unsigned char *cursor = (const unsigned char *) subtask->input.cursor;
+  const unsigned char *limit = (const unsigned char *) subtask->input.limit;
+  char buffer[BLOCK_LINES * (MIME_LINE_LENGTH + 1)];
+  int quadruplets = *counter;
+
+  while (limit - cursor >= 3)
+    {
+      char *output = buffer;
+
+      while (limit - cursor >= 3
+	     && output + MIME_LINE_LENGTH + 1 <= buffer + sizeof buffer)
+	{
+	  /* Wrap line every 76 characters, then fill a line as much as the
+	     input allows.  */
+
+	  const unsigned char *line_limit;
+
+	  if (quadruplets == MIME_LINE_LENGTH / 4)
+	    {
+	      *output++ = '\n';
+	      quadruplets = 0;
+	    }
+	  line_limit = cursor + 3 * MIN ((size_t) (limit - cursor) / 3,
+					 (size_t) (MIME_LINE_LENGTH / 4
+						   - quadruplets));
+	  quadruplets += (line_limit - cursor) / 3;
+
+	  for (; cursor < line_limit; cursor += 3)
+	    {
+	      unsigned value = cursor[0] << 16 | cursor[1] << 8 | cursor[2];
+
+	      output[0] = base64_value_to_char[BIT_MASK (6) & value >> 18];
+	      output[1] = base64_value_to_char[BIT_MASK (6) & value >> 12];
+	      output[2] = base64_value_to_char[BIT_MASK (6) & value >> 6];
+	      output[3] = base64_value_to_char[BIT_MASK (6) & value];
+	      output += 4;
+	    }
+	}
+      recode_put_bytes (buffer, output - buffer, subtask);
+    }
+
+  subtask->input.cursor = (const char *) cursor;
+  *counter = quadruplets;
+}
+
 static bool
 transform_data_base64 (RECODE_SUBTASK subtask)
 {
@@ -81,6 +141,9 @@ transform_data_base64 (RECODE_SUBTASK subtask)
   unsigned value;
 
   counter = 0;
+  if (BLOCK_INPUT (subtask))
+    encode_base64_block (subtask, &counter);
+
   while (true)
     {
       character = recode_get_byte (subtask);
@@ -138,6 +201,64 @@ transform_data_base64 (RECODE_SUBTASK subtask)
   SUBTASK_RETURN (subtask);
 }
 
+/*-------------------------------------------------------------------------.
+| Decode from the in-memory input of SUBTASK as many complete and valid    |
+| quadruplets as possible, and the canonical line ends between them.       |
+| *COUNTER is the number of quadruplets already read on the current input  |
+| line, it gets updated.  Stop before anything else, padding included, as  |
+| the byte path should handle it and produce the proper diagnostics.       |
+`-------------------------------------------------------------------------*/
+
+static void
+decode_base64_block (RECODE_SUBTASK subtask, int *counter)
+{
+  const unsigned char *cursor = (const unsigned char *) subtask->input.cursor;
+  const unsigned char *limit = (const unsigned char *) subtask->input.limit;
+  char buffer[BLOCK_LINES * MIME_LINE_LENGTH / 4 * 3];
+  int quadruplets = *counter;
+  bool going = true;
+
+  while (going)
+    {
+      char *output = buffer;
+
+      while (output + 3 <= buffer + sizeof buffer)
+	{
+	  if (limit - cursor >= 4
+	      && IS_BASE64 (cursor[0]) && IS_BASE64 (cursor[1])
+	      && IS_BASE64 (cursor[2]) && IS_BASE64 (cursor[3]))
+	    {
+	      unsigned value = (base64_char_to_value[cursor[0]] << 18
+				| base64_char_to_value[cursor[1]] << 12
+				| base64_char_to_value[cursor[2]] << 6
+				| base64_char_to_value[cursor[3]]);
+
+	      output[0] = value >> 16;
+	      output[1] = BIT_MASK (8) & value >> 8;
+	      output[2] = BIT_MASK (8) & value;
+	      output += 3;
+	      cursor += 4;
+	      quadruplets++;
+	    }
+	  else if (cursor < limit && *cursor == '\n'
+		   && quadruplets == MIME_LINE_LENGTH / 4)
+	    {
+	      cursor++;
+	      quadruplets = 0;
+	    }
+	  else
+	    {
+	      going = false;
+	      break;
+	    }
+	}
+      recode_put_bytes (buffer, output - buffer, subtask);
+    }
+
+  subtask->input.cursor = (const char *) cursor;
+  *counter = quadruplets;
+}
+
 static bool
 transform_base64_data (RECODE_SUBTASK subtask)
 {
@@ -147,6 +268,11 @@ transform_base64_data (RECODE_SUBTASK subtask)
 
   while (true)
     {
+      /* Decode regular input in bulk, whenever possible.  */
+
+      if (BLOCK_INPUT (subtask))
+	decode_base64_block (subtask, &counter);
+
       /* Accept wrapping lines, reversibly if at each 76 characters.  */
 
       character = recode_get_byte (subtask);
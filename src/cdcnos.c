@@ -159,14 +159,13 @@ init_ascii_cdcnos (RECODE_STEP step,
 		   RECODE_CONST_OPTION_LIST before_options,
 		   RECODE_CONST_OPTION_LIST after_options)
 {
-  RECODE_OUTER outer = request->outer;
   const char **table;
   int counter;
 
   if (before_options || after_options)
     return false;
 
-  if (!ALLOC (table, 256, const char *))
+  if (!ARENA_ALLOC (table, request->arena, 256, const char *))
     return false;
   for (counter = 0; counter < 128; counter++)
     table[counter] = translation_table[counter];
@@ -175,7 +174,6 @@ init_ascii_cdcnos (RECODE_STEP step,
 
   step->step_type = RECODE_BYTE_TO_STRING;
   step->step_table = table;
-  step->step_table_term_routine = free;
   return true;
 }
 
@@ -32,12 +32,12 @@
    did not limit the length of a combining sequence, yet it is usually small.
    Also, I did not put any limit on the number of possibly equivalent
    sequences.  For combining, for each possible partial match in any sequence,
-   there is a state.  States corresponding to the scan of a single code are
-   found by hash coding, while other states are linearly searched on a linked
-   list of possible shifts, rooted on the state corresponding to the partial
-   sequence, but without its last code.  I expect this combination of methods
-   to execute reasonably fast.  Exploding is much simpler, and I merely use
-   hash coding.
+   there is a state.  States are compiled into tables when the step is
+   initialised, so shifting to the next state is a search among the sorted
+   shifts of the current state, and the output needed when a sequence is
+   abandoned is precomputed for each state.  Exploding is much simpler: the
+   high byte of a code selects a row of offsets, and its low byte an offset
+   within that row, into a pool holding all exploded sequences.
 
    The less satisfactory aspects are that the user interface is still very
    crude.  For the time being, I merely added a "combined" charset: combining
@@ -59,61 +59,160 @@
 
 /* Exploding.  */
 
-/*---------------------------.
-| Initialize for exploding.  |
-`---------------------------*/
+/* Explode data is a pool of sequences, each being a code followed by its
+   exploded characters and DONE.  The table gives, for any code, the offset
+   in the pool of the characters it explodes into, or 0 if it does not
+   explode.  The high byte of a code selects a row of offsets, indexed by
+   the low byte.  Row 0 is all zeroes, and single byte codes always use the
+   row of high byte 0, so byte input merely indexes one flat row.  */
 
-static size_t
-combined_hash (const void *void_data, size_t table_size)
+struct explode_table
 {
-  const unsigned short *data = (const unsigned short *) void_data;
-
-  return *data % table_size;
-}
+  const unsigned short *pool;	/* explode data, holding all sequences */
+  unsigned short row[256];	/* row of offsets, given the high byte */
+  unsigned *offset;		/* offsets in the pool, by row and low byte */
+};
 
-static bool
-combined_compare (const void *void_first, const void *void_second)
-{
-  const unsigned short *first = (const unsigned short *) void_first;
-  const unsigned short *second = (const unsigned short *) void_second;
+#define EXPLODE_OFFSET(Table, Code) \
+  ((Table)->offset[(Table)->row[BIT_MASK (8) & (Code) >> 8] << 8 \
+		   | (BIT_MASK (8) & (Code))])
 
-  return *first == *second;
-}
+/*---------------------------.
+| Initialize for exploding.  |
+`---------------------------*/
 
 bool
 recode_init_explode (RECODE_STEP step,
-	      RECODE_CONST_REQUEST request _GL_UNUSED,
+	      RECODE_CONST_REQUEST request,
 	      RECODE_CONST_OPTION_LIST before_options,
 	      RECODE_CONST_OPTION_LIST after_options)
 {
   const unsigned short *data = (const unsigned short *) step->step_table;
-  Hash_table *table;
+  const unsigned short *cursor;
+  struct explode_table *table;
+  unsigned row_count = 1;
 
   if (before_options || after_options)
     return false;
 
-  table = hash_initialize (0, NULL, combined_hash, combined_compare, NULL);
+  if (!ARENA_ALLOC (table, request->arena, 1, struct explode_table))
+    return false;
 
-  if (!table)
+  /* Give a row to each high byte in use.  */
+
+  if (data)
+    for (cursor = data; *cursor != DONE; cursor++)
+      {
+	if (!table->row[BIT_MASK (8) & *cursor >> 8])
+	  table->row[BIT_MASK (8) & *cursor >> 8] = row_count++;
+	while (*cursor != DONE)
+	  cursor++;
+      }
+
+  if (!ARENA_ALLOC (table->offset, request->arena, row_count << 8, unsigned))
     return false;
+  table->pool = data;
+
+  /* The first sequence given for a code wins.  */
+
+  if (data)
+    for (cursor = data; *cursor != DONE; cursor++)
+      {
+	if (!EXPLODE_OFFSET (table, *cursor))
+	  EXPLODE_OFFSET (table, *cursor) = cursor + 1 - data;
+	while (*cursor != DONE)
+	  cursor++;
+      }
+
   step->step_type = RECODE_EXPLODE_STEP;
   step->step_table = table;
-  step->step_table_term_routine = (void (*) (void *)) hash_free;
+  return true;
+}
 
-  if (!data)
-    return true;
+/*---------------------------------------------------------------------.
+| Copy from memory the run of bytes which do not explode, for SUBTASK. |
+| If WIDE, write them as UCS-2 characters.                             |
+`---------------------------------------------------------------------*/
 
-  while (*data != DONE)
+static void
+copy_plain_bytes (const struct explode_table *table, bool wide,
+		  RECODE_SUBTASK subtask)
+{
+  const unsigned *offset = table->offset + (table->row[0] << 8);
+  const char *start = subtask->input.cursor;
+  const char *cursor = start;
+
+  if (!wide)
+    {
+      while (cursor < subtask->input.limit
+	     && !offset[BIT_MASK (8) & *cursor])
+	cursor++;
+      if (cursor > start)
+	recode_put_bytes (start, cursor - start, subtask);
+    }
+  else
     {
-      if (!hash_insert (table, data))
-	return false;
+      char buffer[BUFSIZ];
+      char *output = buffer;
 
-      while (*data != DONE)
-	data++;
-      data++;
+      while (cursor < subtask->input.limit
+	     && !offset[BIT_MASK (8) & *cursor])
+	{
+	  *output++ = 0;
+	  *output++ = *cursor++;
+	  if (output == buffer + BUFSIZ)
+	    {
+	      recode_put_bytes (buffer, BUFSIZ, subtask);
+	      output = buffer;
+	    }
+	}
+      if (output > buffer)
+	recode_put_bytes (buffer, output - buffer, subtask);
     }
 
-  return true;
+  subtask->input.cursor = cursor;
+}
+
+/*----------------------------------------------------------------------.
+| Copy from memory the run of UCS-2 characters which do not explode,    |
+| for SUBTASK.  If WIDE, write them as UCS-2 characters, else write     |
+| their low byte.  The byte order should already be known.  Byte order  |
+| marks are left over, for recode_get_ucs2 to diagnose.                 |
+`----------------------------------------------------------------------*/
+
+static void
+copy_plain_ucs2 (const struct explode_table *table, bool wide,
+		 RECODE_SUBTASK subtask)
+{
+  /* Position of the most significant byte within each pair.  */
+  int high = subtask->task->swap_input == RECODE_SWAP_YES;
+  const char *cursor = subtask->input.cursor;
+  char buffer[BUFSIZ];
+  char *output = buffer;
+
+  while (subtask->input.limit - cursor >= 2)
+    {
+      unsigned code = ((BIT_MASK (8) & cursor[high]) << 8
+		       | (BIT_MASK (8) & cursor[!high]));
+
+      if (code == BYTE_ORDER_MARK || code == BYTE_ORDER_MARK_SWAPPED
+	  || EXPLODE_OFFSET (table, code))
+	break;
+
+      if (wide)
+	*output++ = code >> 8;
+      *output++ = code;
+      cursor += 2;
+      if (output >= buffer + BUFSIZ - 1)
+	{
+	  recode_put_bytes (buffer, output - buffer, subtask);
+	  output = buffer;
+	}
+    }
+
+  if (output > buffer)
+    recode_put_bytes (buffer, output - buffer, subtask);
+  subtask->input.cursor = cursor;
 }
 
 /*------------------------------------.
@@ -123,17 +222,25 @@ recode_init_explode (RECODE_STEP step,
 bool
 recode_explode_byte_byte (RECODE_SUBTASK subtask)
 {
-  Hash_table *table = (Hash_table *) subtask->step->step_table;
+  const struct explode_table *table
+    = (const struct explode_table *) subtask->step->step_table;
   unsigned value;
 
-  while (value = recode_get_byte (subtask), value != (unsigned)EOF)
+  while (true)
     {
-      unsigned short lookup = value;
-      unsigned short *result = (unsigned short *) hash_lookup (table, &lookup);
+      unsigned offset;
+
+      if (BLOCK_INPUT (subtask))
+	copy_plain_bytes (table, false, subtask);
 
-      if (result)
+      if (value = recode_get_byte (subtask), value == (unsigned)EOF)
+	break;
+
+      offset = EXPLODE_OFFSET (table, value);
+      if (offset)
 	{
-	  result++;
+	  const unsigned short *result = table->pool + offset;
+
 	  while (*result != DONE && *result != ELSE)
 	    {
 	      recode_put_byte (*result, subtask);
@@ -150,17 +257,26 @@ recode_explode_byte_byte (RECODE_SUBTASK subtask)
 bool
 recode_explode_ucs2_byte (RECODE_SUBTASK subtask)
 {
-  Hash_table *table = (Hash_table *) subtask->step->step_table;
+  const struct explode_table *table
+    = (const struct explode_table *) subtask->step->step_table;
   unsigned value;
 
-  while (recode_get_ucs2 (&value, subtask))
+  while (true)
     {
-      unsigned short lookup = value;
-      unsigned short *result = (unsigned short *) hash_lookup (table, &lookup);
+      unsigned offset;
+
+      if (BLOCK_INPUT (subtask)
+	  && subtask->task->swap_input != RECODE_SWAP_UNDECIDED)
+	copy_plain_ucs2 (table, false, subtask);
 
-      if (result)
+      if (!recode_get_ucs2 (&value, subtask))
+	break;
+
+      offset = EXPLODE_OFFSET (table, value);
+      if (offset)
 	{
-	  result++;
+	  const unsigned short *result = table->pool + offset;
+
 	  while (*result != DONE && *result != ELSE)
 	    {
 	      recode_put_byte (*result, subtask);
@@ -177,7 +293,8 @@ recode_explode_ucs2_byte (RECODE_SUBTASK subtask)
 bool
 recode_explode_byte_ucs2 (RECODE_SUBTASK subtask)
 {
-  Hash_table *table = (Hash_table *) subtask->step->step_table;
+  const struct explode_table *table
+    = (const struct explode_table *) subtask->step->step_table;
   unsigned value;
 
   if (value = recode_get_byte (subtask), value != (unsigned)EOF)
@@ -187,19 +304,21 @@ recode_explode_byte_ucs2 (RECODE_SUBTASK subtask)
 
       while (true)
 	{
-	  unsigned short lookup = value;
-	  unsigned short *result
-            = (unsigned short *) hash_lookup (table, &lookup);
+	  unsigned offset = EXPLODE_OFFSET (table, value);
 
-	  if (result)
+	  if (offset)
 	    {
-	      result++;
+	      const unsigned short *result = table->pool + offset;
+
 	      while (*result != DONE && *result != ELSE)
 		recode_put_ucs2 (*result++, subtask);
 	    }
 	  else
 	    recode_put_ucs2 (value, subtask);
 
+	  if (BLOCK_INPUT (subtask))
+	    copy_plain_bytes (table, true, subtask);
+
 	  if (value = recode_get_byte (subtask), value == (unsigned)EOF)
 	    break;
 	}
@@ -211,7 +330,8 @@ recode_explode_byte_ucs2 (RECODE_SUBTASK subtask)
 bool
 recode_explode_ucs2_ucs2 (RECODE_SUBTASK subtask)
 {
-  Hash_table *table = (Hash_table *) subtask->step->step_table;
+  const struct explode_table *table
+    = (const struct explode_table *) subtask->step->step_table;
   unsigned value;
 
   if (recode_get_ucs2 (&value, subtask))
@@ -221,19 +341,21 @@ recode_explode_ucs2_ucs2 (RECODE_SUBTASK subtask)
 
       while (true)
 	{
-	  unsigned short lookup = value;
-	  unsigned short *result
-            = (unsigned short *) hash_lookup (table, &lookup);
+	  unsigned offset = EXPLODE_OFFSET (table, value);
 
-	  if (result)
+	  if (offset)
 	    {
-	      result++;
+	      const unsigned short *result = table->pool + offset;
+
 	      while (*result != DONE && *result != ELSE)
 		recode_put_ucs2 (*result++, subtask);
 	    }
 	  else
 	    recode_put_ucs2 (value, subtask);
 
+	  if (BLOCK_INPUT (subtask))
+	    copy_plain_ucs2 (table, true, subtask);
+
 	  if (!recode_get_ucs2 (&value, subtask))
 	    break;
 	}
@@ -247,11 +369,12 @@ recode_explode_ucs2_ucs2 (RECODE_SUBTASK subtask)
 /* A combining state represents the history of reading one or more characters
    while forming a combining sequence.
 
-   Hash coding is used to find an initial state from the first character in a
-   sequence.  If that state is not found, the character surely does not start
-   any sequence.  For subsequent characters, possible shifted states from the
-   current state are kept on that state, as a linked chain.  This combination
-   of methods is expected to behave fast enough in practice.  */
+   While initialising, states are first grown as a tree.  Hash coding is used
+   to find an initial state from the first character in a sequence.  For
+   subsequent characters, possible shifted states from the current state are
+   kept on that state, as a linked chain.  Once all sequences are known, the
+   tree is compiled into a single block of tables, which the transformations
+   merely index, and the tree itself is discarded.  */
 
 struct state
 {
@@ -260,6 +383,35 @@ struct state
   struct state *shift;		/* list of states for one more character */
   struct state *unshift;	/* state for one less character (back link) */
   struct state *next;		/* next state in a linked chain of states */
+  unsigned number;		/* while compiling, number of this state */
+  unsigned first_shift;		/* while compiling, index of first shift */
+  unsigned shift_count;		/* while compiling, number of shifts */
+  unsigned output_count;	/* while compiling, length of backtrack */
+};
+
+/* Compiled states are numbered breadth first, state 0 standing for no
+   character read yet.  The shifts out of any state then lead to consecutive
+   states, so shift K merely leads to state K + 1, and only the triggering
+   character of each shift needs to be kept.  The shifts out of a state are
+   sorted by character, yet shifts out of state 0 for characters below 256,
+   the most frequent lookup by far, are also directly indexed.  When no
+   shift applies from a state, the backtrack output of that state stands
+   for the partial sequence it represents.  */
+
+struct combine_state
+{
+  unsigned first_shift;		/* index of first shift in `character' */
+  unsigned shift_count;		/* number of shifts out of this state */
+  unsigned first_output;	/* index of backtrack output in `output' */
+  unsigned output_count;	/* number of characters in backtrack output */
+};
+
+struct combine_table
+{
+  unsigned initial[256];	/* state reached from state 0, or 0 */
+  struct combine_state *state;	/* all states, by number */
+  unsigned short *character;	/* character triggering each shift */
+  unsigned short *output;	/* all backtrack outputs, concatenated */
 };
 
 /*---------------------------.
@@ -283,24 +435,22 @@ state_compare (const void *void_first, const void *void_second)
   return first->character == second->character;
 }
 
-static void
-state_free (void *void_state)
+static int
+state_order (const void *void_first, const void *void_second)
 {
-  struct state *state = (struct state *) void_state;
-  struct state *shift = state->shift;
+  const struct state *first = *(const struct state *const *) void_first;
+  const struct state *second = *(const struct state *const *) void_second;
 
-  while (shift != NULL)
-    {
-      struct state *next_shift = shift->next;
-      state_free (shift);
-      shift = next_shift;
-    }
-  free (state);
+  return first->character - second->character;
 }
 
+/* States of the tree are allocated in a temporary ARENA, so they never need
+   to be freed one at a time.  COUNT tallies them.  */
+
 static struct state *
 prepare_shifted_state (struct state *state, unsigned character,
-		       RECODE_CONST_STEP step)
+		       Hash_table *table, struct recode_arena *arena,
+		       size_t *count)
 {
   if (state)
     {
@@ -312,7 +462,7 @@ prepare_shifted_state (struct state *state, unsigned character,
 	else
 	  shift = shift->next;
 
-      if (shift = (struct state *) malloc (sizeof (struct state)), !shift)
+      if (!ARENA_ALLOC (shift, arena, 1, struct state))
 	return NULL;
 
       shift->character = character;
@@ -321,18 +471,18 @@ prepare_shifted_state (struct state *state, unsigned character,
       shift->unshift = state;
       shift->next = state->shift;
       state->shift = shift;
+      ++*count;
       return shift;
     }
   else
     {
-      Hash_table *table = (Hash_table *) step->step_table;
       struct state lookup;
 
       lookup.character = character;
       state = (struct state *) hash_lookup (table, &lookup);
       if (!state)
 	{
-	  if (state = (struct state *) malloc (sizeof (struct state)), !state)
+	  if (!ARENA_ALLOC (state, arena, 1, struct state))
 	    return NULL;
 
 	  state->character = character;
@@ -343,95 +493,225 @@ prepare_shifted_state (struct state *state, unsigned character,
 
 	  if (!hash_insert (table, state))
 	    return NULL;
+	  ++*count;
 	}
       return state;
     }
 }
 
-static struct state *
-find_shifted_state (struct state *state, unsigned character,
-		    RECODE_CONST_STEP step)
+/*-------------------------------------------------------------------------.
+| Compile the COUNT states of the tree, whose initial states are in TABLE, |
+| into a single block for STEP.  Return false if memory is exhausted.      |
+`-------------------------------------------------------------------------*/
+
+static bool
+compile_states (RECODE_STEP step, RECODE_CONST_REQUEST request,
+		Hash_table *table, size_t count)
 {
-  if (state)
+  RECODE_OUTER outer = request->outer;
+  struct state initial;
+  struct state **queue;
+  struct combine_table *compiled;
+  size_t output_count = 0;
+  size_t head;
+  size_t tail;
+
+  /* Number states breadth first, each list of shifts being sorted.  The
+     initial state has number 0, and the number of a state is its index in
+     QUEUE.  Also get the length of each backtrack output.  */
+
+  if (!ALLOC (queue, count + 1, struct state *))
+    return false;
+
+  initial.number = 0;
+  initial.first_shift = 0;
+  initial.shift_count = hash_get_entries (table, (void **) queue + 1, count);
+  initial.output_count = 0;
+  queue[0] = &initial;
+  qsort (queue + 1, initial.shift_count, sizeof (struct state *), state_order);
+  for (tail = 1; tail < 1 + initial.shift_count; tail++)
+    queue[tail]->number = tail;
+
+  for (head = 1; head < tail; head++)
     {
-      struct state *shift = state->shift;
+      struct state *state = queue[head];
+      struct state *shift;
+      size_t shift_number;
+
+      state->first_shift = tail - 1;
+      for (shift = state->shift; shift; shift = shift->next)
+	queue[tail++] = shift;
+      state->shift_count = tail - 1 - state->first_shift;
+      qsort (queue + 1 + state->first_shift, state->shift_count,
+	     sizeof (struct state *), state_order);
+      for (shift_number = 1 + state->first_shift; shift_number < tail;
+	   shift_number++)
+	queue[shift_number]->number = shift_number;
+
+      state->output_count = (state->result == NOT_A_CHARACTER
+			     ? state->unshift->output_count + 1 : 1);
+      output_count += state->output_count;
+    }
 
-      while (shift)
-	if (shift->character == character)
-	  return shift;
-	else
-	  shift = shift->next;
+  /* Fill the compiled tables, all within a single block.  */
 
-      return NULL;
+  if (!ARENA_ALLOC_SIZE (compiled, request->arena,
+			 sizeof (struct combine_table)
+			 + (count + 1) * sizeof (struct combine_state)
+			 + (count + output_count) * sizeof (unsigned short),
+			 struct combine_table))
+    {
+      recode_free (outer, queue);
+      return false;
     }
-  else
+  compiled->state = (struct combine_state *) (compiled + 1);
+  compiled->character = (unsigned short *) (compiled->state + count + 1);
+  compiled->output = compiled->character + count;
+
+  output_count = 0;
+  for (head = 0; head < tail; head++)
     {
-      Hash_table *table = (Hash_table *) step->step_table;
-      struct state lookup;
+      struct state *state = queue[head];
+      struct combine_state *cursor = compiled->state + head;
 
-      lookup.character = character;
-      return (struct state *) hash_lookup (table, &lookup);
+      cursor->first_shift = state->first_shift;
+      cursor->shift_count = state->shift_count;
+      cursor->first_output = output_count;
+      cursor->output_count = state->output_count;
+
+      if (head == 0)
+	continue;
+
+      compiled->character[head - 1] = state->character;
+      if (state->unshift == NULL && state->character < 256)
+	compiled->initial[state->character] = head;
+      if (state->result == NOT_A_CHARACTER)
+	{
+	  /* The state for one less character precedes this one.  */
+
+	  const struct combine_state *previous
+	    = compiled->state + state->unshift->number;
+
+	  memcpy (compiled->output + output_count,
+		  compiled->output + previous->first_output,
+		  previous->output_count * sizeof (unsigned short));
+	  compiled->output[output_count + previous->output_count]
+	    = state->character;
+	}
+      else
+	compiled->output[output_count] = state->result;
+      output_count += state->output_count;
     }
+
+  recode_free (outer, queue);
+  step->step_table = compiled;
+  return true;
 }
 
 bool
 recode_init_combine (RECODE_STEP step,
-	      RECODE_CONST_REQUEST request _GL_UNUSED,
+	      RECODE_CONST_REQUEST request,
 	      RECODE_CONST_OPTION_LIST before_options,
 	      RECODE_CONST_OPTION_LIST after_options)
 {
   const unsigned short *data = (const unsigned short *) step->step_table;
+  struct recode_arena *arena;
   Hash_table *table;
+  size_t count = 0;
+  bool success;
 
   if (before_options || after_options)
     return false;
 
-  table = hash_initialize (0, NULL, state_hash, state_compare, state_free);
-
+  table = hash_initialize (0, NULL, state_hash, state_compare, NULL);
   if (!table)
     return false;
-  step->step_type = RECODE_COMBINE_STEP;
-  step->step_table = table;
-  step->step_table_term_routine = (void (*) (void *)) hash_free;
 
-  if (!data)
-    return true;
-
-  while (*data != DONE)
+  arena = recode_new_arena (request->outer, 4096);
+  if (!arena)
     {
-      unsigned short result = *data++;
-      struct state *state = NULL;
+      hash_free (table);
+      return false;
+    }
 
-      while (*data != DONE)
-	if (*data == ELSE)
-	  {
-	    if (state)
-	      {
-		if (state->result != NOT_A_CHARACTER)
-		  abort ();
-		state->result = result;
-		state = NULL;
-	      }
-	    data++;
-	  }
-	else
+  success = true;
+  if (data)
+    while (success && *data != DONE)
+      {
+	unsigned short result = *data++;
+	struct state *state = NULL;
+
+	while (*data != DONE)
+	  if (*data == ELSE)
+	    {
+	      if (state)
+		{
+		  if (state->result != NOT_A_CHARACTER)
+		    abort ();
+		  state->result = result;
+		  state = NULL;
+		}
+	      data++;
+	    }
+	  else
+	    {
+	      state = prepare_shifted_state (state, *data++, table, arena,
+					     &count);
+	      if (!state)
+		{
+		  success = false;
+		  break;
+		}
+	    }
+
+	if (state)
 	  {
-	    state = prepare_shifted_state (state, *data++, step);
-	    if (!state)
-	      return false;
+	    if (state->result != NOT_A_CHARACTER
+		&& state->result != state->character)
+	      abort ();
+	    state->result = result;
 	  }
+	data++;
+      }
 
-      if (state)
-	{
-	  if (state->result != NOT_A_CHARACTER
-	      && state->result != state->character)
-	    abort ();
-	  state->result = result;
-	}
-      data++;
+  step->step_type = RECODE_COMBINE_STEP;
+  success = success && compile_states (step, request, table, count);
+
+  recode_delete_arena (arena);
+  hash_free (table);
+  return success;
+}
+
+/*--------------------------------------------------------------------.
+| Return the state reached from STATE in TABLE by reading CHARACTER,  |
+| or 0 if no combining sequence goes that way.                        |
+`--------------------------------------------------------------------*/
+
+static unsigned
+find_shifted_state (const struct combine_table *table, unsigned state,
+		    unsigned character)
+{
+  const struct combine_state *from = table->state + state;
+  unsigned low = from->first_shift;
+  unsigned high = low + from->shift_count;
+
+  if (state == 0 && character < 256)
+    return table->initial[character];
+
+  while (low < high)
+    {
+      unsigned middle = (low + high) / 2;
+
+      if (table->character[middle] < character)
+	low = middle + 1;
+      else
+	high = middle;
     }
 
-  return true;
+  if (low < from->first_shift + from->shift_count
+      && table->character[low] == character)
+    return low + 1;
+  return 0;
 }
 
 /*------------------.
@@ -442,33 +722,34 @@ recode_init_combine (RECODE_STEP step,
    we ought to backtrack until such a terminal character if found, then output
    this resulting character for representing the partial sequence which ends
    with that state.  Then, we merely copy characters seen after that state.
+   All this has been precomputed as the backtrack output of each state.
 
    This approach does not properly scan for combinings which might exist in
    the copied characters, presuming that this case does not occur in practice.
    If we later find that it does, backtracing will have to be revisited.  */
 
 static void
-backtrack_byte (struct state *state, RECODE_SUBTASK subtask)
+backtrack_byte (const struct combine_table *table, unsigned state,
+		RECODE_SUBTASK subtask)
 {
-  if (state->result == NOT_A_CHARACTER)
-    {
-      backtrack_byte (state->unshift, subtask);
-      recode_put_byte (state->character, subtask);
-    }
-  else
-    recode_put_byte (state->result, subtask);
+  const unsigned short *cursor
+    = table->output + table->state[state].first_output;
+  const unsigned short *limit = cursor + table->state[state].output_count;
+
+  for (; cursor < limit; cursor++)
+    recode_put_byte (*cursor, subtask);
 }
 
 static void
-backtrack_ucs2 (struct state *state,  RECODE_SUBTASK subtask)
+backtrack_ucs2 (const struct combine_table *table, unsigned state,
+		RECODE_SUBTASK subtask)
 {
-  if (state->result == NOT_A_CHARACTER)
-    {
-      backtrack_ucs2 (state->unshift, subtask);
-      recode_put_ucs2 (state->character, subtask);
-    }
-  else
-    recode_put_ucs2 (state->result, subtask);
+  const unsigned short *cursor
+    = table->output + table->state[state].first_output;
+  const unsigned short *limit = cursor + table->state[state].output_count;
+
+  for (; cursor < limit; cursor++)
+    recode_put_ucs2 (*cursor, subtask);
 }
 
 /*------------------------------------.
@@ -478,15 +759,16 @@ backtrack_ucs2 (struct state *state,  RECODE_SUBTASK subtask)
 bool
 recode_combine_byte_byte (RECODE_SUBTASK subtask)
 {
-  struct state *state = NULL;
+  const struct combine_table *table
+    = (const struct combine_table *) subtask->step->step_table;
+  unsigned state = 0;
   unsigned value;
 
   if (value = recode_get_byte (subtask), value != (unsigned)EOF)
     {
       while (true)
 	{
-	  struct state *shift
-	    = find_shifted_state (state, value, subtask->step);
+	  unsigned shift = find_shifted_state (table, state, value);
 
 	  if (shift)
 	    {
@@ -496,11 +778,8 @@ recode_combine_byte_byte (RECODE_SUBTASK subtask)
 	    }
 	  else if (state)
 	    {
-	      if (state->result == NOT_A_CHARACTER)
-		backtrack_byte (state, subtask);
-	      else
-		recode_put_byte (state->result, subtask);
-	      state = NULL;
+	      backtrack_byte (table, state, subtask);
+	      state = 0;
 	    }
 	  else
 	    {
@@ -511,12 +790,7 @@ recode_combine_byte_byte (RECODE_SUBTASK subtask)
 	}
 
       if (state)
-	{
-	  if (state->result == NOT_A_CHARACTER)
-	    backtrack_byte (state, subtask);
-	  else
-	    recode_put_byte (state->result, subtask);
-	}
+	backtrack_byte (table, state, subtask);
     }
 
   SUBTASK_RETURN (subtask);
@@ -525,15 +799,16 @@ recode_combine_byte_byte (RECODE_SUBTASK subtask)
 bool
 recode_combine_ucs2_byte (RECODE_SUBTASK subtask)
 {
-  struct state *state = NULL;
+  const struct combine_table *table
+    = (const struct combine_table *) subtask->step->step_table;
+  unsigned state = 0;
   unsigned value;
 
   if (recode_get_ucs2 (&value, subtask))
     {
       while (true)
 	{
-	  struct state *shift
-	    = find_shifted_state (state, value, subtask->step);
+	  unsigned shift = find_shifted_state (table, state, value);
 
 	  if (shift)
 	    {
@@ -543,11 +818,8 @@ recode_combine_ucs2_byte (RECODE_SUBTASK subtask)
 	    }
 	  else if (state)
 	    {
-	      if (state->result == NOT_A_CHARACTER)
-		backtrack_byte (state, subtask);
-	      else
-		recode_put_byte (state->result, subtask);
-	      state = NULL;
+	      backtrack_byte (table, state, subtask);
+	      state = 0;
 	    }
 	  else
 	    {
@@ -558,12 +830,7 @@ recode_combine_ucs2_byte (RECODE_SUBTASK subtask)
 	}
 
       if (state)
-	{
-	  if (state->result == NOT_A_CHARACTER)
-	    backtrack_byte (state, subtask);
-	  else
-	    recode_put_byte (state->result, subtask);
-	}
+	backtrack_byte (table, state, subtask);
     }
 
   SUBTASK_RETURN (subtask);
@@ -572,19 +839,20 @@ recode_combine_ucs2_byte (RECODE_SUBTASK subtask)
 bool
 recode_combine_byte_ucs2 (RECODE_SUBTASK subtask)
 {
+  const struct combine_table *table
+    = (const struct combine_table *) subtask->step->step_table;
   unsigned value;
 
   if (value = recode_get_byte (subtask), value != (unsigned)EOF)
     {
-      struct state *state = NULL;
+      unsigned state = 0;
 
       if (subtask->task->byte_order_mark)
 	recode_put_ucs2 (BYTE_ORDER_MARK, subtask);
 
       while (true)
 	{
-	  struct state *shift
-	    = find_shifted_state (state, value, subtask->step);
+	  unsigned shift = find_shifted_state (table, state, value);
 
 	  if (shift)
 	    {
@@ -594,11 +862,8 @@ recode_combine_byte_ucs2 (RECODE_SUBTASK subtask)
 	    }
 	  else if (state)
 	    {
-	      if (state->result == NOT_A_CHARACTER)
-		backtrack_ucs2 (state, subtask);
-	      else
-		recode_put_ucs2 (state->result, subtask);
-	      state = NULL;
+	      backtrack_ucs2 (table, state, subtask);
+	      state = 0;
 	    }
 	  else
 	    {
@@ -609,12 +874,7 @@ recode_combine_byte_ucs2 (RECODE_SUBTASK subtask)
 	}
 
       if (state)
-	{
-	  if (state->result == NOT_A_CHARACTER)
-	    backtrack_ucs2 (state, subtask);
-	  else
-	    recode_put_ucs2 (state->result, subtask);
-	}
+	backtrack_ucs2 (table, state, subtask);
     }
 
   SUBTASK_RETURN (subtask);
@@ -623,19 +883,20 @@ recode_combine_byte_ucs2 (RECODE_SUBTASK subtask)
 bool
 recode_combine_ucs2_ucs2 (RECODE_SUBTASK subtask)
 {
+  const struct combine_table *table
+    = (const struct combine_table *) subtask->step->step_table;
   unsigned value;
 
   if (recode_get_ucs2 (&value, subtask))
     {
-      struct state *state = NULL;
+      unsigned state = 0;
 
       if (subtask->task->byte_order_mark)
 	recode_put_ucs2 (BYTE_ORDER_MARK, subtask);
 
       while (true)
 	{
-	  struct state *shift
-	    = find_shifted_state (state, value, subtask->step);
+	  unsigned shift = find_shifted_state (table, state, value);
 
 	  if (shift)
 	    {
@@ -645,11 +906,8 @@ recode_combine_ucs2_ucs2 (RECODE_SUBTASK subtask)
 	    }
 	  else if (state)
 	    {
-	      if (state->result == NOT_A_CHARACTER)
-		backtrack_ucs2 (state, subtask);
-	      else
-		recode_put_ucs2 (state->result, subtask);
-	      state = NULL;
+	      backtrack_ucs2 (table, state, subtask);
+	      state = 0;
 	    }
 	  else
 	    {
@@ -660,12 +918,7 @@ recode_combine_ucs2_ucs2 (RECODE_SUBTASK subtask)
 	}
 
       if (state)
-	{
-	  if (state->result == NOT_A_CHARACTER)
-	    backtrack_ucs2 (state, subtask);
-	  else
-	    recode_put_ucs2 (state->result, subtask);
-	}
+	backtrack_ucs2 (table, state, subtask);
     }
 
   SUBTASK_RETURN (subtask);
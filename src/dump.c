@@ -22,7 +22,7 @@
 #include "decsteps.h"
 
 /* Constants for the possible bases.  If these are reordered, so should be
-   the initialisers for the three tables which follow.  */
+   the initialisers for the two tables which follow.  */
 enum base
 {
   OCTAL,
@@ -30,13 +30,6 @@ enum base
   HEXADECIMAL
 };
 
-/* Printing format to use, depending on both the base and the actual number
-   of bytes.  The zero byte case is unused.  */
-static const char *format_table[3][5]
-  = {{ NULL, "0%03o", "0%06o", "0%08o", "0%011o" },
-     { NULL, "%3u", "%5u", "%8u", "%10u" },
-     { NULL, "0x%02X", "0x%04X", "0x%06X", "0x%08X" }};
-
 /* Number of active digits to expect, depending on both the base and the
    actual number of bytes.  The zero byte case is unused.  The values do not
    include the `0' octal prefix nor the `0x' for hexadecimal.  */
@@ -53,20 +46,164 @@ static unsigned per_line_table[3][5]
      { 0, 15, 10, 7, 5 },
      { 0, 12, 8, 7, 6 }};
 
+/* Pairs of digits for all values of a byte in hexadecimal, and for all
+   values below one hundred in decimal, for formatting two digits at once.  */
+static const char hexadecimal_pairs[2 * 256 + 1] =
+  "000102030405060708090A0B0C0D0E0F"
+  "101112131415161718191A1B1C1D1E1F"
+  "202122232425262728292A2B2C2D2E2F"
+  "303132333435363738393A3B3C3D3E3F"
+  "404142434445464748494A4B4C4D4E4F"
+  "505152535455565758595A5B5C5D5E5F"
+  "606162636465666768696A6B6C6D6E6F"
+  "707172737475767778797A7B7C7D7E7F"
+  "808182838485868788898A8B8C8D8E8F"
+  "909192939495969798999A9B9C9D9E9F"
+  "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+  "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+  "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+  "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+  "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+  "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+static const char decimal_pairs[2 * 100 + 1] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/*-------------------------------------------------------------------------.
+| Format VALUE, made up of BYTE_COUNT bytes, in the given BASE at OUTPUT,  |
+| and return the position after it.  The formats are respectively those of |
+| "0%0*o", "%*u" and "0x%0*X" from printf, the width being given by        |
+| width_table.  Nothing gets NUL-terminated.                               |
+`-------------------------------------------------------------------------*/
+
+static char *
+format_value (char *output, enum base base, unsigned byte_count,
+	      unsigned value)
+{
+  unsigned width = width_table[base][byte_count];
+  char *cursor;
+
+  switch (base)
+    {
+    case OCTAL:
+      *output++ = '0';
+      for (cursor = output + width; cursor > output; value >>= 3)
+	*--cursor = '0' + (BIT_MASK (3) & value);
+      break;
+
+    case DECIMAL:
+      cursor = output + width;
+      while (value >= 100)
+	{
+	  cursor -= 2;
+	  memcpy (cursor, decimal_pairs + 2 * (value % 100), 2);
+	  value /= 100;
+	}
+      if (value >= 10)
+	{
+	  cursor -= 2;
+	  memcpy (cursor, decimal_pairs + 2 * value, 2);
+	}
+      else
+	*--cursor = '0' + value;
+      while (cursor > output)
+	*--cursor = ' ';
+      break;
+
+    case HEXADECIMAL:
+      *output++ = '0';
+      *output++ = 'x';
+      for (cursor = output + width; cursor > output; value >>= 8)
+	{
+	  cursor -= 2;
+	  memcpy (cursor, hexadecimal_pairs + 2 * (BIT_MASK (8) & value), 2);
+	}
+      break;
+    }
+
+  return output + width;
+}
+
+/*-------------------------------------------------------------------------.
+| Dump all complete units of SIZE bytes from the in-memory input of        |
+| SUBTASK, preparing many lines at once.  *COLUMN is the number of values  |
+| already on the current output line, it gets updated.  Any incomplete     |
+| unit at the end is left in the input, for the byte path to handle.       |
+`-------------------------------------------------------------------------*/
+
+static void
+dump_block (RECODE_SUBTASK subtask, enum base base, unsigned size,
+	    unsigned *column)
+{
+  const unsigned char *cursor = (const unsigned char *) subtask->input.cursor;
+  const unsigned char *limit = (const unsigned char *) subtask->input.limit;
+  unsigned per_line = per_line_table[base][size];
+  char buffer[BUFSIZ];
+  char *output = buffer;
+
+  /* Room for a delimiter, a prefix and the widest value.  */
+#define MAXIMUM_ITEM (2 + 2 + 11)
+
+  while ((size_t) (limit - cursor) >= size)
+    {
+      unsigned value = 0;
+      unsigned counter;
+
+      for (counter = 0; counter < size; counter++)
+	value = (value << 8) | *cursor++;
+
+      /* Write delimiters.  */
+
+      if (*column == per_line)
+	{
+	  *output++ = ',';
+	  *output++ = '\n';
+	  *column = 1;
+	}
+      else if (*column == 0)
+	*column = 1;
+      else
+	{
+	  *output++ = ',';
+	  *output++ = ' ';
+	  (*column)++;
+	}
+
+      output = format_value (output, base, size, value);
+      if (output + MAXIMUM_ITEM > buffer + sizeof buffer)
+	{
+	  recode_put_bytes (buffer, output - buffer, subtask);
+	  output = buffer;
+	}
+    }
+  recode_put_bytes (buffer, output - buffer, subtask);
+
+#undef MAXIMUM_ITEM
+
+  subtask->input.cursor = (const char *) cursor;
+}
+
 static bool
 dump (RECODE_SUBTASK subtask,
       enum base base, unsigned size)
 {
   unsigned per_line = per_line_table[base][size];
   unsigned column = 0;
-  int character = recode_get_byte (subtask);
+  int character;
 
+  if (BLOCK_INPUT (subtask))
+    dump_block (subtask, base, size, &column);
+
+  character = recode_get_byte (subtask);
   while (character != EOF)
     {
       unsigned value = BIT_MASK (8) & character;
       unsigned byte_count;
       char buffer[14];
-      const char *cursor;
 
       for (byte_count = 1; byte_count < size; byte_count++)
 	{
@@ -95,12 +232,9 @@ dump (RECODE_SUBTASK subtask,
 
       /* Write formatted value.  */
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-      sprintf (buffer, format_table[base][byte_count], value);
-#pragma GCC diagnostic pop
-      for (cursor = buffer; *cursor; cursor++)
-	recode_put_byte (*cursor, subtask);
+      recode_put_bytes (buffer,
+			format_value (buffer, base, byte_count, value) - buffer,
+			subtask);
 
       /* Prepare for next iteration.  */
 
@@ -112,13 +246,21 @@ dump (RECODE_SUBTASK subtask,
   SUBTASK_RETURN (subtask);
 }
 
+/* Read one byte from the input of SUBTASK as recode_get_byte does, yet
+   without calling a function whenever this input lies in memory.  */
+#define GET_BYTE(Subtask) \
+  (BLOCK_INPUT (Subtask)						\
+   ? ((Subtask)->input.cursor < (Subtask)->input.limit			\
+      ? (unsigned char) *(Subtask)->input.cursor++ : EOF)		\
+   : recode_get_byte (Subtask))
+
 static bool
 undump (RECODE_SUBTASK subtask,
 	enum base expected_base, unsigned expected_size)
 {
   unsigned per_line = per_line_table[expected_base][expected_size];
   unsigned column = 0;
-  int character = recode_get_byte (subtask);
+  int character = GET_BYTE (subtask);
   bool last_is_short = false;
   bool comma_on_last = character != EOF;
 
@@ -138,7 +280,7 @@ undump (RECODE_SUBTASK subtask,
 	  else
 	    RETURN_IF_NOGO (RECODE_NOT_CANONICAL, subtask);
 
-	  character = recode_get_byte (subtask);
+	  character = GET_BYTE (subtask);
 	}
       if (character == EOF)
 	{
@@ -152,7 +294,7 @@ undump (RECODE_SUBTASK subtask,
 
       if (character == '0')
 	{
-	  character = recode_get_byte (subtask);
+	  character = GET_BYTE (subtask);
 
 	  if (character == 'x')
 	    {
@@ -160,7 +302,7 @@ undump (RECODE_SUBTASK subtask,
 		RETURN_IF_NOGO (RECODE_NOT_CANONICAL, subtask);
 	      width = 0;
 	      base = HEXADECIMAL;
-	      character = recode_get_byte (subtask);
+	      character = GET_BYTE (subtask);
 	    }
 	  else if (character >= '0' && character <= '9')
 	    {
@@ -188,9 +330,9 @@ undump (RECODE_SUBTASK subtask,
 
 	  RETURN_IF_NOGO (RECODE_NOT_CANONICAL, subtask);
 	  while (character != '\n' && character != EOF)
-	    character = recode_get_byte (subtask);
+	    character = GET_BYTE (subtask);
 	  if (character == '\n')
-	    character = recode_get_byte (subtask);
+	    character = GET_BYTE (subtask);
 
 	  continue;
 	}
@@ -207,7 +349,7 @@ undump (RECODE_SUBTASK subtask,
 	    {
 	      value = (value << 3) | (character - '0');
 	      width++;
-	      character = recode_get_byte (subtask);
+	      character = GET_BYTE (subtask);
 	    }
 	  break;
 
@@ -216,7 +358,7 @@ undump (RECODE_SUBTASK subtask,
 	    {
 	      value = value * 10 + character - '0';
 	      width++;
-	      character = recode_get_byte (subtask);
+	      character = GET_BYTE (subtask);
 	    }
 	  break;
 
@@ -226,19 +368,19 @@ undump (RECODE_SUBTASK subtask,
 	      {
 		value = (value << 4) | (character - '0');
 		width++;
-		character = recode_get_byte (subtask);
+		character = GET_BYTE (subtask);
 	      }
 	    else if (character >= 'A' && character <= 'F')
 	      {
 		value = (value << 4) | (character - 'A' + 10);
 		width++;
-		character = recode_get_byte (subtask);
+		character = GET_BYTE (subtask);
 	      }
 	    else if (character >= 'a' && character <= 'f')
 	      {
 		value = (value << 4) | (character - 'a' + 10);
 		width++;
-		character = recode_get_byte (subtask);
+		character = GET_BYTE (subtask);
 	      }
 	    else
 	      break;
@@ -294,24 +436,24 @@ undump (RECODE_SUBTASK subtask,
       if (!comma_on_last)
 	{
 	  if (character == '\n')
-	    character = recode_get_byte (subtask);
+	    character = GET_BYTE (subtask);
 	  else
 	    RETURN_IF_NOGO (RECODE_NOT_CANONICAL, subtask);
 	}
       else
 	{
-	  character = recode_get_byte (subtask);
+	  character = GET_BYTE (subtask);
 	  if (character == ' ')
 	    {
 	      column++;
-	      character = recode_get_byte (subtask);
+	      character = GET_BYTE (subtask);
 	    }
 	  else if (character == '\n')
 	    {
 	      if (column + 1!= per_line)
 		RETURN_IF_NOGO (RECODE_NOT_CANONICAL, subtask);
 	      column = 0;
-	      character = recode_get_byte (subtask);
+	      character = GET_BYTE (subtask);
 	    }
 	}
     }
@@ -161,11 +161,10 @@ init_ebcdic_ascii (RECODE_STEP step,
   if (before_options || after_options)
     return false;
 
-  if (step->step_table = recode_invert_table (request->outer, ascii_to_ebcdic),
+  if (step->step_table = recode_invert_table (request, ascii_to_ebcdic),
       step->step_table)
     {
       step->step_type = RECODE_BYTE_TO_BYTE;
-      step->step_table_term_routine = free;
       return true;
     }
   else
@@ -197,11 +196,10 @@ init_ebcdic_ccc_ascii (RECODE_STEP step,
   if (before_options || after_options)
     return false;
 
-  if (step->step_table = recode_invert_table (request->outer, ascii_to_ebcdic_ccc),
+  if (step->step_table = recode_invert_table (request, ascii_to_ebcdic_ccc),
       step->step_table)
     {
       step->step_type = RECODE_BYTE_TO_BYTE;
-      step->step_table_term_routine = free;
       return true;
     }
   else
@@ -232,11 +230,10 @@ init_ebcdic_ibm_ascii (RECODE_STEP step,
   if (before_options || after_options)
     return false;
 
-  if (step->step_table = recode_invert_table (request->outer, ascii_to_ebcdic_ibm),
+  if (step->step_table = recode_invert_table (request, ascii_to_ebcdic_ibm),
       step->step_table)
     {
       step->step_type = RECODE_BYTE_TO_BYTE;
-      step->step_table_term_routine = free;
       return true;
     }
   else
@@ -25,12 +25,83 @@
 #define LF 10			/* line feed */
 #define OLD_EOF 26		/* oldish end of file */
 
+/*-------------------------------------------------------------------------.
+| Return the first position from CURSOR to LIMIT holding any of the COUNT  |
+| bytes in BYTES, or LIMIT if there is none.  NEXT[INDEX] remembers where  |
+| BYTES[INDEX] was last found, initially NULL, and gets refreshed only     |
+| once CURSOR went past it.  So, memchr goes over the whole text only once |
+| for each byte.                                                           |
+`-------------------------------------------------------------------------*/
+
+static const char *
+find_any (const char *cursor, const char *limit,
+	  const char *bytes, const char **next, int count)
+{
+  const char *result = limit;
+
+  for (int index = 0; index < count; index++)
+    {
+      if (!next[index] || next[index] < cursor)
+	{
+	  const char *found = memchr (cursor, bytes[index], limit - cursor);
+
+	  next[index] = found ? found : limit;
+	}
+      if (next[index] < result)
+	result = next[index];
+    }
+  return result;
+}
+
+/*-------------------------------------------------------------------------.
+| Recode the in-memory input of SUBTASK between the CR and LF conventions, |
+| FROM being the line end replaced by TO.  Lines are copied whole, while   |
+| a TO already in the input is either replaced by FROM, or kept, if        |
+| STRICT, with a diagnostic.                                               |
+`-------------------------------------------------------------------------*/
+
+static bool
+swap_line_ends_block (RECODE_SUBTASK subtask, char from, char to, bool strict)
+{
+  const char *cursor = subtask->input.cursor;
+  const char *limit = subtask->input.limit;
+  const char bytes[2] = {from, to};
+  const char *next[2] = {NULL, NULL};
+
+  while (cursor < limit)
+    {
+      const char *stop = find_any (cursor, limit, bytes, next, 2);
+
+      recode_put_bytes (cursor, stop - cursor, subtask);
+      if (stop == limit)
+	break;
+      cursor = stop + 1;
+
+      if (*stop == from)
+	recode_put_byte (to, subtask);
+      else if (!strict)
+	recode_put_byte (from, subtask);
+      else
+	{
+	  subtask->input.cursor = cursor;
+	  RETURN_IF_NOGO (RECODE_AMBIGUOUS_OUTPUT, subtask);
+	  recode_put_byte (to, subtask);
+	}
+    }
+
+  subtask->input.cursor = limit;
+  SUBTASK_RETURN (subtask);
+}
+
 static bool
 transform_data_cr (RECODE_SUBTASK subtask)
 {
   bool strict = subtask->step->fallback_routine != recode_reversibility;
   int character;
 
+  if (BLOCK_INPUT (subtask))
+    return swap_line_ends_block (subtask, '\n', CR, strict);
+
   while (character = recode_get_byte (subtask), character != EOF)
     switch (character)
       {
@@ -60,6 +131,9 @@ transform_cr_data (RECODE_SUBTASK subtask)
   bool strict = subtask->step->fallback_routine != recode_reversibility;
   int character;
 
+  if (BLOCK_INPUT (subtask))
+    return swap_line_ends_block (subtask, CR, '\n', strict);
+
   while (character = recode_get_byte (subtask), character != EOF)
     switch (character)
       {
@@ -86,8 +160,55 @@ transform_cr_data (RECODE_SUBTASK subtask)
 static bool
 transform_data_crlf (RECODE_SUBTASK subtask)
 {
-  int character = recode_get_byte (subtask);
+  int character;
 
+  if (BLOCK_INPUT (subtask))
+    {
+      /* Copy whole lines, stopping only on special characters.  */
+
+      const char *cursor = subtask->input.cursor;
+      const char *limit = subtask->input.limit;
+      const char bytes[3] = {LF, CR, OLD_EOF};
+      const char *next[3] = {NULL, NULL, NULL};
+
+      while (cursor < limit)
+	{
+	  const char *stop = find_any (cursor, limit, bytes, next, 3);
+
+	  recode_put_bytes (cursor, stop - cursor, subtask);
+	  if (stop == limit)
+	    break;
+	  cursor = stop + 1;
+
+	  switch (*stop)
+	    {
+	    case LF:
+	      recode_put_bytes ("\r\n", 2, subtask);
+	      break;
+
+	    case CR:
+	      /* A following LF is seen here, yet later recoded on its own.  */
+
+	      if (cursor < limit && *cursor == LF)
+		{
+		  subtask->input.cursor = cursor + 1;
+		  RETURN_IF_NOGO (RECODE_AMBIGUOUS_OUTPUT, subtask);
+		}
+	      recode_put_byte (CR, subtask);
+	      break;
+
+	    default:
+	      subtask->input.cursor = cursor;
+	      RETURN_IF_NOGO (RECODE_AMBIGUOUS_OUTPUT, subtask);
+	      recode_put_byte (OLD_EOF, subtask);
+	    }
+	}
+
+      subtask->input.cursor = limit;
+      SUBTASK_RETURN (subtask);
+    }
+
+  character = recode_get_byte (subtask);
   while (character != EOF)
     switch (character)
       {
@@ -119,8 +240,56 @@ transform_data_crlf (RECODE_SUBTASK subtask)
 static bool
 transform_crlf_data (RECODE_SUBTASK subtask)
 {
-  int character = recode_get_byte (subtask);
+  int character;
+
+  if (BLOCK_INPUT (subtask))
+    {
+      /* Copy whole lines, stopping only on special characters.  */
+
+      const char *cursor = subtask->input.cursor;
+      const char *limit = subtask->input.limit;
+      const char bytes[3] = {CR, LF, OLD_EOF};
+      const char *next[3] = {NULL, NULL, NULL};
+
+      while (cursor < limit)
+	{
+	  const char *stop = find_any (cursor, limit, bytes, next, 3);
+
+	  recode_put_bytes (cursor, stop - cursor, subtask);
+	  if (stop == limit)
+	    break;
+	  cursor = stop + 1;
+
+	  switch (*stop)
+	    {
+	    case CR:
+	      if (cursor < limit && *cursor == LF)
+		{
+		  recode_put_byte ('\n', subtask);
+		  cursor++;
+		}
+	      else
+		recode_put_byte (CR, subtask);
+	      break;
+
+	    case LF:
+	      subtask->input.cursor = cursor;
+	      RETURN_IF_NOGO (RECODE_AMBIGUOUS_OUTPUT, subtask);
+	      recode_put_byte (LF, subtask);
+	      break;
+
+	    default:
+	      subtask->input.cursor = cursor;
+	      RETURN_IF_NOGO (RECODE_NOT_CANONICAL, subtask);
+	      SUBTASK_RETURN (subtask);
+	    }
+	}
+
+      subtask->input.cursor = limit;
+      SUBTASK_RETURN (subtask);
+    }
 
+  character = recode_get_byte (subtask);
   while (character != EOF)
     switch (character)
       {
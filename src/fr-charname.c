@@ -21,47 +21,40 @@
 #include "common.h"
 #include "fr-charname.h"
 
-/*--------------------------------------------------------------------.
-| Return a statically allocated full charname associated with a given |
-| SYMBOL, or NULL if not found.					      |
-`--------------------------------------------------------------------*/
+#if MAX_CHARNAME_LENGTH >= RECODE_CHARNAME_SIZE
+# error "RECODE_CHARNAME_SIZE is too small"
+#endif
+
+/*-------------------------------------------------------------------.
+| Write into BUFFER, having room for RECODE_CHARNAME_SIZE bytes, the |
+| full charname associated with UCS2, and return BUFFER.  Return     |
+| NULL if not found.                                                 |
+`-------------------------------------------------------------------*/
 
 const char *
-recode_ucs2_to_french_charname (int ucs2)
+recode_ucs2_to_french_charname_r (int ucs2, char *buffer)
 {
-  static char result[MAX_CHARNAME_LENGTH + 1];
-  int first;
-  int last;
-  int middle;
+  int index;
   int value;
   const char *in;
   char *out;
   const char *cursor;
 
-  /* Find the symbol by binary searching the charname table.  */
+  /* Find the symbol through the two-level index of the charname table.  */
 
-  first = 0;
-  last = NUMBER_OF_CHARNAMES;
-  while (first < last)
-    {
-      middle = (first + last) / 2;
-      if (charname[middle].code < ucs2)
-	first = middle + 1;
-      else if (charname[middle].code > ucs2)
-	last = middle;
-      else
-	break;
-    }
+  if (ucs2 < 0 || ucs2 > 0xFFFF)
+    return NULL;
+  index = charname_row[charname_page[ucs2 >> 8]][ucs2 & 0xFF];
 
   /* If the UCS value has not been found, return the NULL string.  */
 
-  if (first >= last)
+  if (index < 0)
     return NULL;
 
   /* Else, construct the resulting charname.  */
 
-  out = NULL;
-  for (in = charname[middle].crypted; *in; in++)
+  out = buffer;
+  for (in = charname[index].crypted; *in; in++)
     {
 
       /* Decrypt the next word.  */
@@ -73,10 +66,8 @@ recode_ucs2_to_french_charname (int ucs2)
 
       /* Copy it.  */
 
-      if (out)
+      if (out != buffer)
 	*out++ = ' ';
-      else
-	out = result;
 
       for (cursor = word[value]; *cursor; cursor++)
 	*out++ = *cursor;
@@ -84,7 +75,19 @@ recode_ucs2_to_french_charname (int ucs2)
 
   /* Return the result.  */
 
-  if (out)
-    *out = NUL;
-  return result;
+  *out = NUL;
+  return buffer;
+}
+
+/*---------------------------------------------------------------.
+| Same as above, but into a statically allocated buffer, so this |
+| is not reentrant.                                              |
+`---------------------------------------------------------------*/
+
+const char *
+recode_ucs2_to_french_charname (int ucs2)
+{
+  static char result[RECODE_CHARNAME_SIZE];
+
+  return recode_ucs2_to_french_charname_r (ucs2, result);
 }
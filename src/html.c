@@ -20,7 +20,8 @@
 #include "config.h"
 #include "common.h"
 #include "decsteps.h"
-#include "hash.h"
+
+#include "minmax.h"
 
 /* FIXME: An @code{HTML} text which has spurious semi-colons to end entities
    (in strict mode) or does not always have them (in non-strict mode) is
@@ -65,7 +66,7 @@
 #define ENTRY(Code, String, Flags) \
   { Code, Flags, String }
 
-static struct ucs2_to_string translations [] =
+static const struct ucs2_to_string translations [] =
   {
     ENTRY (33, "excl",      0       				 ),
     ENTRY (34, "quot",      0 | V00 	  | V20 | V27 | V32 | V40),
@@ -382,36 +383,39 @@ static struct ucs2_to_string translations [] =
   };
 
 #undef ENTRY
+
+/* Indices into `translations', generated from it by `tables.py'.  */
+#include "htmlentity.h"
 
 /* UCS-2 to HTML.  */
 
-/*-------------------------------------.
-| Return hash value given TABLE_SIZE.  |
-`-------------------------------------*/
+/*---------------------------------------------------------------------.
+| Return the translation for CODE which is part of HTML versions MASK, |
+| or NULL.  The page of CODE selects a row of cells, the cell gives    |
+| the first translation for CODE, and other ones for the same code in  |
+| other HTML versions follow through `entity_next'.                    |
+`---------------------------------------------------------------------*/
 
-static size_t
-code_hash (const void *void_data, size_t table_size)
+static const struct ucs2_to_string *
+find_code (unsigned code, unsigned mask, bool diacritics_only)
 {
-  struct ucs2_to_string const *data = (struct ucs2_to_string const *) void_data;
+  int index = entity_row[entity_page[BIT_MASK (8) & code >> 8]]
+    [BIT_MASK (8) & code];
 
-  return data->code % table_size;
-}
+  if (diacritics_only && code <= 128)
+    return NULL;
 
-/*----------------------------------------.
-| Say if two translations are identical.  |
-`----------------------------------------*/
+  for (; index >= 0; index = entity_next[index])
+    if (translations[index].flags & mask)
+      return translations + index;
 
-static bool
-code_compare (const void *void_first, const void *void_second)
-{
-  struct ucs2_to_string const *first
-    = (struct ucs2_to_string const *) void_first;
-  struct ucs2_to_string const *second
-    = (struct ucs2_to_string const *) void_second;
-
-  return first->code == second->code;
+  return NULL;
 }
 
+/* Say if CODE may be written as itself, when no entity is found for it.  */
+#define PLAIN_CODE(Code) \
+  (((Code) >= 32 || (Code) == '\n' || (Code) == '\t') && (Code) < 127)
+
 /*-----------------.
 | Initialisation.  |
 `-----------------*/
@@ -423,28 +427,14 @@ init_ucs2_html (RECODE_STEP step,
 		RECODE_CONST_OPTION_LIST after_options,
 		unsigned mask)
 {
-  Hash_table *table;
-  struct ucs2_to_string const *cursor;
-
   if (before_options || after_options)
     return false;
 
-  table = hash_initialize (0, NULL, code_hash, code_compare, NULL);
-  if (!table)
+  if (!ARENA_ALLOC (step->local, request->arena, 1, unsigned))
     return false;
-
-  for (cursor = translations; cursor->code; cursor++)
-    if (cursor->flags & mask
-	&& (!request->diacritics_only || cursor->code > 128))
-      if (!hash_insert (table, cursor))
-	{
-	  hash_free (table);
-	  return false;
-	}
+  *(unsigned *) step->local = mask;
 
   step->step_type = RECODE_UCS2_TO_STRING;
-  step->step_table = table;
-  step->step_table_term_routine = (void (*) (void *)) hash_free;
   return true;
 }
 
@@ -508,6 +498,43 @@ init_ucs2_html_v40 (RECODE_STEP step,
     init_ucs2_html (step, request, before_options, after_options, V40);
 }
 
+/*---------------------------------------------------------------------.
+| Copy from memory the run of UCS-2 characters which SUBTASK would     |
+| write as themselves, one byte each.  The byte order should already   |
+| be known.                                                            |
+`---------------------------------------------------------------------*/
+
+static void
+copy_plain_run (RECODE_SUBTASK subtask, unsigned mask, bool diacritics_only)
+{
+  /* Position of the most significant byte within each pair.  */
+  int high = subtask->task->swap_input == RECODE_SWAP_YES;
+  const char *cursor = subtask->input.cursor;
+  char buffer[BUFSIZ];
+  char *output = buffer;
+
+  while (subtask->input.limit - cursor >= 2)
+    {
+      unsigned code = ((BIT_MASK (8) & cursor[high]) << 8
+		       | (BIT_MASK (8) & cursor[!high]));
+
+      if (!PLAIN_CODE (code) || find_code (code, mask, diacritics_only))
+	break;
+
+      *output++ = code;
+      cursor += 2;
+      if (output == buffer + BUFSIZ)
+	{
+	  recode_put_bytes (buffer, BUFSIZ, subtask);
+	  output = buffer;
+	}
+    }
+
+  if (output > buffer)
+    recode_put_bytes (buffer, output - buffer, subtask);
+  subtask->input.cursor = cursor;
+}
+
 /*-----------------.
 | Transformation.  |
 `-----------------*/
@@ -515,16 +542,22 @@ init_ucs2_html_v40 (RECODE_STEP step,
 static bool
 transform_ucs2_html (RECODE_SUBTASK subtask)
 {
-  Hash_table *table = (Hash_table *) subtask->step->step_table;
+  RECODE_CONST_REQUEST request = subtask->task->request;
+  unsigned mask = *(unsigned *) subtask->step->local;
   unsigned value;
 
-  while (recode_get_ucs2 (&value, subtask))
+  while (true)
     {
-      struct ucs2_to_string lookup;
-      struct ucs2_to_string *entry;
+      const struct ucs2_to_string *entry;
+
+      if (BLOCK_INPUT (subtask)
+	  && subtask->task->swap_input != RECODE_SWAP_UNDECIDED)
+	copy_plain_run (subtask, mask, request->diacritics_only);
 
-      lookup.code = value;
-      entry = (struct ucs2_to_string *) hash_lookup (table, &lookup);
+      if (!recode_get_ucs2 (&value, subtask))
+	break;
+
+      entry = find_code (value, mask, request->diacritics_only);
       if (entry)
 	{
 	  const char *cursor = entry->string;
@@ -537,7 +570,7 @@ transform_ucs2_html (RECODE_SUBTASK subtask)
 	    }
 	  recode_put_byte (';', subtask);
 	}
-      else if ((value < 32 && value != '\n' && value != '\t') || value >= 127)
+      else if (!PLAIN_CODE (value))
 	{
 	  unsigned divider = 10000;
 
@@ -572,29 +605,40 @@ transform_ucs2_html (RECODE_SUBTASK subtask)
 &gt;	{ if (request->diacritics_only) ECHO; else recode_put_ucs2 (62, subtask); }
 */
 
-/*-------------------------------------.
-| Return hash value given TABLE_SIZE.  |
-`-------------------------------------*/
-
-static size_t
-string_hash (const void *void_data, size_t table_size)
-{
-  struct ucs2_to_string const *data = (struct ucs2_to_string const *) void_data;
+/* Mix a name hash VALUE with SEED into a slot of `entity_slot'.  */
+#define ENTITY_SLOT(Value, Seed) \
+  ((((Value) ^ (Seed)) * 2654435761u & 0xFFFFFFFFu) \
+   >> (32 - ENTITY_SLOT_BITS))
 
-  return hash_string (data->string, table_size);
-}
+/*---------------------------------------------------------------------.
+| Return the translation named NAME which is part of HTML versions     |
+| MASK, or NULL.  The name is hashed once, its bucket selects a seed,  |
+| and the seeded slot holds the only candidate worth comparing.        |
+`---------------------------------------------------------------------*/
 
-/*----------------------------------------.
-| Say if two translations are identical.  |
-`----------------------------------------*/
-
-static bool
-string_compare (const void *void_first, const void *void_second)
+static const struct ucs2_to_string *
+find_entity (const char *name, unsigned mask, bool diacritics_only)
 {
-  struct ucs2_to_string const *first = (struct ucs2_to_string const *) void_first;
-  struct ucs2_to_string const *second = (struct ucs2_to_string const *) void_second;
-
-  return strcmp (first->string, second->string) == 0;
+  const struct ucs2_to_string *entry;
+  const unsigned char *cursor;
+  unsigned value = 2166136261u;
+  int index;
+
+  for (cursor = (const unsigned char *) name; *cursor; cursor++)
+    value = (value ^ *cursor) * 16777619u & 0xFFFFFFFFu;
+
+  index = entity_slot[ENTITY_SLOT (value,
+				   entity_seed[value % ENTITY_BUCKET_COUNT])];
+  if (index < 0)
+    return NULL;
+
+  entry = translations + index;
+  if (!(entry->flags & mask)
+      || (diacritics_only && entry->code <= 128)
+      || strcmp (entry->string, name) != 0)
+    return NULL;
+
+  return entry;
 }
 
 /*-----------------.
@@ -608,28 +652,14 @@ init_html_ucs2 (RECODE_STEP step,
 		RECODE_CONST_OPTION_LIST after_options,
 		unsigned mask)
 {
-  Hash_table *table;
-  struct ucs2_to_string const *cursor;
-
   if (before_options || after_options)
     return false;
 
-  table = hash_initialize (0, NULL, string_hash, string_compare, NULL);
-  if (!table)
+  if (!ARENA_ALLOC (step->local, request->arena, 1, unsigned))
     return false;
-
-  for (cursor = translations; cursor->code; cursor++)
-    if (cursor->flags & mask
-	&& (!request->diacritics_only || cursor->code > 128))
-      if (!hash_insert (table, cursor))
-	{
-	  hash_free (table);
-	  return false;
-	}
+  *(unsigned *) step->local = mask;
 
   step->step_type = RECODE_STRING_TO_UCS2;
-  step->step_table = table;
-  step->step_table_term_routine = (void (*) (void *)) hash_free;
   return true;
 }
 
@@ -693,6 +723,32 @@ init_html_v40_ucs2 (RECODE_STEP step,
     init_html_ucs2 (step, request, before_options, after_options, V40);
 }
 
+/*---------------------------------------------------------------------.
+| Write the bytes from CURSOR to LIMIT as UCS-2 characters, for        |
+| SUBTASK.                                                             |
+`---------------------------------------------------------------------*/
+
+static void
+put_widened_run (const char *cursor, const char *limit,
+		 RECODE_SUBTASK subtask)
+{
+  char buffer[BUFSIZ];
+
+  while (cursor < limit)
+    {
+      size_t count = MIN ((size_t) (limit - cursor), BUFSIZ / 2);
+      char *output = buffer;
+      size_t counter;
+
+      for (counter = 0; counter < count; counter++)
+	{
+	  *output++ = 0;
+	  *output++ = *cursor++;
+	}
+      recode_put_bytes (buffer, output - buffer, subtask);
+    }
+}
+
 /*-----------------.
 | Transformation.  |
 `-----------------*/
@@ -847,12 +903,10 @@ transform_html_ucs2 (RECODE_SUBTASK subtask)
 
 	    if (valid)
 	      {
-		struct ucs2_to_string lookup;
-		struct ucs2_to_string *entry;
+		const struct ucs2_to_string *entry
+		  = find_entity (buffer, *(unsigned *) subtask->step->local,
+				 request->diacritics_only);
 
-		lookup.string = buffer;
-		entry = (struct ucs2_to_string *) hash_lookup
-		  ((const Hash_table *) subtask->step->step_table, &lookup);
 		if (entry)
 		  {
 		    recode_put_ucs2 (entry->code, subtask);
@@ -880,7 +934,22 @@ transform_html_ucs2 (RECODE_SUBTASK subtask)
       }
     else
       {
-	recode_put_ucs2 (input_char, subtask);
+	if (BLOCK_INPUT (subtask))
+	  {
+	    /* Widen the whole run of text up to the next entity at once,
+	       starting with the character already read.  */
+
+	    const char *limit
+	      = memchr (subtask->input.cursor, '&',
+			subtask->input.limit - subtask->input.cursor);
+
+	    if (!limit)
+	      limit = subtask->input.limit;
+	    put_widened_run (subtask->input.cursor - 1, limit, subtask);
+	    subtask->input.cursor = limit;
+	  }
+	else
+	  recode_put_ucs2 (input_char, subtask);
 	input_char = recode_get_byte (subtask);
       }
 
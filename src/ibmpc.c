@@ -296,7 +296,7 @@ init_latin1_ibmpc (RECODE_STEP step,
   if (before_options || after_options)
     return false;
 
-  if (!recode_complete_pairs (request->outer, step,
+  if (!recode_complete_pairs (request, step,
 		       known_pairs, NUMBER_OF_PAIRS, true, true))
     return false;
 
@@ -316,13 +316,12 @@ init_ibmpc_latin1 (RECODE_STEP step,
 		   RECODE_CONST_OPTION_LIST before_options,
 		   RECODE_CONST_OPTION_LIST after_options)
 {
-  RECODE_OUTER outer = request->outer;
   unsigned char *table;
 
   if (before_options || after_options)
     return false;
 
-  if (!recode_complete_pairs (outer, step,
+  if (!recode_complete_pairs (request, step,
 		       known_pairs, NUMBER_OF_PAIRS, true, false))
     return false;
 
@@ -338,11 +337,10 @@ init_ibmpc_latin1 (RECODE_STEP step,
 
   if (request->ascii_graphics)
     {
-      if (!ALLOC (table, 256, unsigned char))
+      if (!ARENA_ALLOC (table, request->arena, 256, unsigned char))
 	return false;
       memcpy (table, step->step_table, 256);
       memcpy (table + 176, convert_rulers, 48);
-      free (step->step_table);
       step->step_table = table;
     }
 
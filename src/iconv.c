@@ -24,24 +24,172 @@
 #include <iconv.h>
 #include "iconvdecl.h"
 
+#include "glthread/lock.h"
+
+/* Opening a conversion descriptor is costly, so each double `iconv' step
+   keeps pools of idle descriptors, opened once and shared by all tasks
+   using the step, which may run in parallel.  A descriptor is reset to
+   its initial shift state before going back into its pool.  */
+
+struct iconv_pool
+{
+  RECODE_OUTER outer;		/* for allocating the array of descriptors */
+  const char *tocode;		/* target charset, with iconv options */
+  const char *fromcode;		/* source charset */
+  gl_lock_t lock;		/* protects the fields below */
+  iconv_t *idle;		/* idle descriptors, ready for use */
+  size_t idle_count;		/* number of descriptors in IDLE */
+  size_t idle_allocated;	/* allocated room in IDLE */
+};
+
+struct iconv_local
+{
+  struct iconv_pool conversion;	/* descriptors doing the step itself */
+  struct iconv_pool check;	/* descriptors validating the source */
+};
+
+/*------------------------------------------------------------------.
+| Get a conversion descriptor from POOL, opening a new one only if  |
+| none is idle.  Return (iconv_t) -1 if none can be opened.         |
+`------------------------------------------------------------------*/
+
+static iconv_t
+acquire_descriptor (struct iconv_pool *pool)
+{
+  iconv_t conversion = (iconv_t) -1;
+
+  gl_lock_lock (pool->lock);
+  if (pool->idle_count > 0)
+    conversion = pool->idle[--pool->idle_count];
+  gl_lock_unlock (pool->lock);
+
+  if (conversion == (iconv_t) -1)
+    conversion = iconv_open (pool->tocode, pool->fromcode);
+  return conversion;
+}
+
+/*--------------------------------------------------------------------.
+| Reset CONVERSION and give it back to POOL, or close it if there is  |
+| no room left to keep it.                                            |
+`--------------------------------------------------------------------*/
+
+static void
+release_descriptor (struct iconv_pool *pool, iconv_t conversion)
+{
+  RECODE_OUTER outer = pool->outer;
+  bool kept = false;
+
+  iconv (conversion, NULL, NULL, NULL, NULL);
+
+  gl_lock_lock (pool->lock);
+  if (pool->idle_count == pool->idle_allocated)
+    {
+      size_t allocated = 2 * pool->idle_allocated + 4;
+      iconv_t *idle = pool->idle;
+
+      if (REALLOC (idle, allocated, iconv_t))
+	{
+	  pool->idle = idle;
+	  pool->idle_allocated = allocated;
+	}
+    }
+  if (pool->idle_count < pool->idle_allocated)
+    {
+      pool->idle[pool->idle_count++] = conversion;
+      kept = true;
+    }
+  gl_lock_unlock (pool->lock);
+
+  if (!kept)
+    iconv_close (conversion);
+}
+
+static void
+init_pool (struct iconv_pool *pool, RECODE_OUTER outer,
+	   const char *tocode, const char *fromcode)
+{
+  pool->outer = outer;
+  pool->tocode = tocode;
+  pool->fromcode = fromcode;
+  gl_lock_init (pool->lock);
+  pool->idle = NULL;
+  pool->idle_count = 0;
+  pool->idle_allocated = 0;
+}
+
+static void
+term_pool (struct iconv_pool *pool)
+{
+  while (pool->idle_count > 0)
+    iconv_close (pool->idle[--pool->idle_count]);
+  recode_free (pool->outer, pool->idle);
+  gl_lock_destroy (pool->lock);
+}
+
 /*--------------------------------------.
 | Use `iconv' to handle a double step.  |
 `--------------------------------------*/
 
 static void
-do_iconv (RECODE_OUTER outer,
-          iconv_t conversion,
+do_iconv (iconv_t conversion,
           char **input, size_t *input_left,
           char **output, size_t *output_left,
           int *saved_errno)
 {
   size_t converted = iconv (conversion, input, input_left, output, output_left);
-  if (converted == (size_t) -1 && !(errno == EILSEQ && outer->force))
+  if (converted == (size_t) -1)
     *saved_errno = errno;
 }
 
 #define BUFFER_SIZE 2048
 
+/*-----------------------------------------------------------------------.
+| Tell whether the INPUT_LEFT bytes at INPUT, which iconv rejected while |
+| doing the step of SUBTASK, are invalid in the source charset or merely |
+| untranslatable into the target charset.  At most BUFFER_SIZE bytes get |
+| checked, a multibyte sequence cut by this limit is not held invalid.   |
+`-----------------------------------------------------------------------*/
+
+static enum recode_error
+rejected_input_error (RECODE_SUBTASK subtask, char *input, size_t input_left)
+{
+  enum recode_error recode_error = RECODE_INVALID_INPUT;
+  struct iconv_local *local = (struct iconv_local *) subtask->step->local;
+  iconv_t check_conversion = acquire_descriptor (&local->check);
+  bool truncated = input_left > BUFFER_SIZE;
+
+  if (truncated)
+    input_left = BUFFER_SIZE;
+
+  /* On error, give up and assume input is invalid.  */
+  if (input_left > 0 && check_conversion != (iconv_t) -1)
+    {
+      /* Assume iconv does not modify its input.  */
+      char *check_input = input;
+      size_t check_input_left = input_left;
+      size_t check_output_left = input_left;
+      char *check_output_buffer, *check_output;
+      RECODE_OUTER outer = subtask->task->request->outer;
+
+      if ((check_output = ALLOC (check_output_buffer, input_left, char)) != NULL)
+        {
+          size_t check_converted = iconv (check_conversion,
+                                          &check_input, &check_input_left,
+                                          &check_output, &check_output_left);
+
+          if (check_converted != (size_t) -1
+	      || (truncated && errno == EINVAL))
+            recode_error = RECODE_UNTRANSLATABLE;
+
+          recode_free (outer, check_output_buffer);
+        }
+    }
+  if (check_conversion != (iconv_t) -1)
+    release_descriptor (&local->check, check_conversion);
+
+  return recode_error;
+}
+
 static bool
 wrapped_transform (iconv_t conversion, RECODE_SUBTASK subtask)
 {
@@ -65,8 +213,7 @@ wrapped_transform (iconv_t conversion, RECODE_SUBTASK subtask)
         {
           /* Drain all accumulated partial state and emit output
              to return to the initial shift state.  */
-          do_iconv (subtask->task->request->outer,
-                    conversion,
+          do_iconv (conversion,
                     NULL, NULL,
                     &output, &output_left,
                     &saved_errno);
@@ -97,8 +244,7 @@ wrapped_transform (iconv_t conversion, RECODE_SUBTASK subtask)
               /* Convert accumulated input and add it to the output buffer.  */
               input = input_buffer;
               input_left = cursor - input_buffer;
-              do_iconv (subtask->task->request->outer,
-                        conversion,
+              do_iconv (conversion,
                         &input, &input_left,
                         &output, &output_left,
                         &saved_errno);
@@ -116,39 +262,11 @@ wrapped_transform (iconv_t conversion, RECODE_SUBTASK subtask)
 	{
 	  if (saved_errno == EILSEQ)
 	    {
-	      /* Check whether the input was really just untranslatable.  */
-              enum recode_error recode_error = RECODE_INVALID_INPUT;
-	      RECODE_CONST_STEP step = subtask->step;
-	      iconv_t check_conversion = iconv_open (step->before->iconv_name,
-						     step->before->iconv_name);
-
-	      /* On error, give up and assume input is invalid.  */
-	      if (input_left > 0 && check_conversion != (iconv_t) -1)
-		{
-                  /* Assume iconv does not modify its input.  */
-		  char *check_input = input;
-		  size_t check_input_left = input_left;
-                  size_t check_output_left = input_left;
-		  char *check_output_buffer, *check_output;
-                  RECODE_OUTER outer = subtask->task->request->outer;
-
-                  if ((check_output = ALLOC (check_output_buffer, input_left, char)) != NULL)
-                    {
-                      size_t check_converted = iconv (check_conversion,
-                                                      &check_input, &check_input_left,
-                                                      &check_output, &check_output_left);
-
-                      if (check_converted != (size_t) -1)
-                        recode_error = RECODE_UNTRANSLATABLE;
-
-                      free (check_output_buffer);
-                    }
-
-                  iconv_close (check_conversion);
-		}
-
 	      /* Invalid or untranslatable input.  */
-	      RETURN_IF_NOGO (recode_error, subtask);
+	      if (!subtask->task->request->outer->force)
+		RETURN_IF_NOGO (rejected_input_error (subtask,
+						      input, input_left),
+				subtask);
 	      /* Ensure we skip at least one byte.
 		 FIXME: We cannot tell how many bytes to skip for
 		 untranslatable input.  The likely result is that we'll
@@ -161,8 +279,11 @@ wrapped_transform (iconv_t conversion, RECODE_SUBTASK subtask)
 	    {
 	      if (input + input_left < input_buffer + BUFFER_SIZE
 		  && input_char == EOF)
-		/* Incomplete multibyte sequence at end of input.  */
-		RETURN_IF_NOGO (RECODE_INVALID_INPUT, subtask);
+		{
+		  /* Incomplete multibyte sequence at end of input.  */
+		  RETURN_IF_NOGO (RECODE_INVALID_INPUT, subtask);
+		  input_left = 0;
+		}
 	    }
 	  else
 	    {
@@ -179,54 +300,359 @@ wrapped_transform (iconv_t conversion, RECODE_SUBTASK subtask)
   SUBTASK_RETURN (subtask);
 }
 
+/*-------------------------------------------------------------------.
+| Make room for at least SIZE more bytes in the memory output of     |
+| SUBTASK, merely emptying it if the output is only being measured.  |
+| Return false if memory is exhausted.                               |
+`-------------------------------------------------------------------*/
+
+static bool
+make_output_room (RECODE_SUBTASK subtask, size_t size)
+{
+  RECODE_OUTER outer = subtask->task->request->outer;
+  struct recode_read_write_text *text = &subtask->output;
+  size_t used;
+  size_t allocated;
+  char *buffer;
+
+  if (subtask->discard_output)
+    {
+      subtask->discarded_bytes += text->cursor - text->buffer;
+      text->cursor = text->buffer;
+    }
+  if ((size_t) (text->limit - text->cursor) >= size)
+    return true;
+
+  used = text->cursor - text->buffer;
+  allocated = (text->limit - text->buffer) * 3 / 2 + size;
+  buffer = text->buffer;
+  if (!REALLOC (buffer, allocated, char))
+    {
+      recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
+      return false;
+    }
+  text->buffer = buffer;
+  text->cursor = buffer + used;
+  text->limit = buffer + allocated;
+  return true;
+}
+
+/*---------------------------------------------------------------------.
+| Same as wrapped_transform, for a SUBTASK having both its input and   |
+| its output in memory.  iconv then reads the whole input in place and |
+| writes straight into the output, which grows as needed.              |
+`---------------------------------------------------------------------*/
+
+static bool
+transform_block (iconv_t conversion, RECODE_SUBTASK subtask)
+{
+  char *input = (char *) subtask->input.cursor;
+  size_t input_left = subtask->input.limit - subtask->input.cursor;
+  bool draining = false;
+
+  while (true)
+    {
+      char *output = subtask->output.cursor;
+      size_t output_left = subtask->output.limit - output;
+      int saved_errno = 0;
+
+      if (draining)
+	/* Return to the initial shift state.  */
+	do_iconv (conversion, NULL, NULL, &output, &output_left,
+		  &saved_errno);
+      else
+	do_iconv (conversion, &input, &input_left, &output, &output_left,
+		  &saved_errno);
+      subtask->input.cursor = input;
+      subtask->output.cursor = output;
+
+      if (saved_errno == 0)
+	{
+	  if (draining)
+	    break;
+	  draining = true;
+	}
+      else if (saved_errno == E2BIG)
+	{
+	  if (!make_output_room (subtask, input_left + 40))
+	    SUBTASK_RETURN (subtask);
+	}
+      else if (saved_errno == EILSEQ)
+	{
+	  /* Invalid or untranslatable input, skip at least one byte.  */
+	  if (!subtask->task->request->outer->force)
+	    RETURN_IF_NOGO (rejected_input_error (subtask, input, input_left),
+			    subtask);
+	  input++;
+	  input_left--;
+	}
+      else if (saved_errno == EINVAL)
+	{
+	  /* Incomplete multibyte sequence at end of input.  */
+	  RETURN_IF_NOGO (RECODE_INVALID_INPUT, subtask);
+	  input += input_left;
+	  input_left = 0;
+	}
+      else
+	{
+	  recode_perror (subtask->task->request->outer, "iconv ()");
+	  recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
+	  SUBTASK_RETURN (subtask);
+	}
+    }
+
+  subtask->input.cursor = input;
+  SUBTASK_RETURN (subtask);
+}
+
 static bool
 ends_with (const char *s, size_t s_len, const char *suff, size_t suff_len)
 {
   return suff_len <= s_len && !memcmp (s + s_len - suff_len, suff, suff_len);
 }
 
+/*-------------------------------------------------------------------.
+| Return, allocated in the arena of REQUEST, the name to give iconv  |
+| for target CHARSET, with iconv options appended.  Return NULL if   |
+| memory is exhausted.                                               |
+`-------------------------------------------------------------------*/
+
 static char *
-iconv_fix_options (RECODE_OUTER outer, const char *charset)
+iconv_fix_options (RECODE_CONST_REQUEST request, const char *charset)
 {
+  RECODE_OUTER outer = request->outer;
   size_t charset_len = strlen (charset);
-  bool translit = false;
+  const char *translit = "";
+  const char *ignore = outer->strict_mapping ? "//IGNORE" : "";
+  char *result;
 
   if (ends_with (charset, charset_len, "-translit", strlen ("-translit")))
     {
-      translit = true;
+      translit = "//TRANSLIT";
       charset_len -= strlen ("-translit");
     }
 
-  char *result;
-  if (asprintf (&result, "%.*s%s%s", (int) charset_len, charset,
-                translit ? "//TRANSLIT" : "",
-                outer->strict_mapping ? "//IGNORE": "")
-      == -1)
+  if (!ARENA_ALLOC (result, request->arena,
+		    charset_len + strlen (translit) + strlen (ignore) + 1,
+		    char))
     return NULL;
+  memcpy (result, charset, charset_len);
+  strcpy (result + charset_len, translit);
+  strcat (result, ignore);
   return result;
 }
 
+static bool
+term_iconv (RECODE_STEP step)
+{
+  struct iconv_local *local = (struct iconv_local *) step->local;
+
+  term_pool (&local->conversion);
+  term_pool (&local->check);
+  return true;
+}
+
+/* Maximum number of bytes iconv may produce for a single input byte,
+   for the step to be turned into a table.  */
+#define PROBE_SIZE 16
+
+/*-----------------------------------------------------------------------.
+| Turn STEP, a double `iconv' step within REQUEST, into a one-to-one or  |
+| one-to-many table step, if CONVERSION maps every byte value by itself  |
+| to a fixed string.  Such a step then merges with neighbouring table    |
+| steps, and iconv is never called on the data.  Each byte is converted  |
+| alone, then all bytes are converted together, which should produce the |
+| same output, so neither charset may keep a shift state.  No byte may   |
+| be held back until the conversion is flushed.  Return false if STEP    |
+| should rather keep using iconv.                                        |
+`-----------------------------------------------------------------------*/
+
+static bool
+table_iconv_step (RECODE_STEP step, RECODE_CONST_REQUEST request,
+		  iconv_t conversion)
+{
+  RECODE_OUTER outer = request->outer;
+  char input[256];
+  char output[256 * PROBE_SIZE];
+  char check[256 * PROBE_SIZE];
+  size_t start[256 + 1];
+  bool one_to_one = true;
+  bool has_nul = false;
+  char *cursor = output;
+  char *input_cursor;
+  char *output_cursor;
+  char *flushed;
+  size_t input_left;
+  size_t output_left;
+  unsigned counter;
+
+  for (counter = 0; counter < 256; counter++)
+    {
+      /* Byte values iconv rejects, or cannot take one at a time, would
+	 need more than a table, so give up on them.  */
+
+      input[counter] = counter;
+      input_cursor = input + counter;
+      input_left = 1;
+      output_cursor = cursor;
+      output_left = PROBE_SIZE;
+
+      iconv (conversion, NULL, NULL, NULL, NULL);
+      if (iconv (conversion, &input_cursor, &input_left,
+		 &output_cursor, &output_left) == (size_t) -1)
+	return false;
+
+      /* A decoder may hold a byte back until it sees whether a combining
+	 character follows, and only write it when flushed.  The output
+	 for such a byte depends on the next one, so give up.  */
+
+      flushed = output_cursor;
+      if (iconv (conversion, NULL, NULL,
+		 &output_cursor, &output_left) == (size_t) -1
+	  || output_cursor != flushed)
+	return false;
+
+      start[counter] = cursor - output;
+      if (output_cursor - cursor != 1)
+	one_to_one = false;
+      if (memchr (cursor, NUL, output_cursor - cursor))
+	has_nul = true;
+      cursor = output_cursor;
+    }
+  start[256] = cursor - output;
+
+  /* Compare with all bytes converted in a row.  */
+
+  input_cursor = input;
+  input_left = 256;
+  output_cursor = check;
+  output_left = sizeof check;
+
+  iconv (conversion, NULL, NULL, NULL, NULL);
+  if (iconv (conversion, &input_cursor, &input_left,
+	     &output_cursor, &output_left) == (size_t) -1
+      || iconv (conversion, NULL, NULL,
+		&output_cursor, &output_left) == (size_t) -1
+      || output_cursor - check != cursor - output
+      || memcmp (check, output, cursor - output) != 0)
+    return false;
+
+  if (one_to_one)
+    {
+      unsigned char *table;
+
+      if (!ARENA_ALLOC (table, request->arena, 256, unsigned char))
+	return false;
+      memcpy (table, output, 256);
+
+      step->step_type = RECODE_BYTE_TO_BYTE;
+      step->step_table = table;
+      step->transform_routine = recode_transform_byte_to_byte;
+      step->quality = outer->quality_byte_to_byte;
+    }
+  else
+    {
+      /* Strings of a one-to-many table cannot hold a NUL byte.  */
+
+      const char **table;
+      char *string;
+
+      if (has_nul)
+	return false;
+
+      /* Allocate everything in one blow.  */
+
+      if (!ARENA_ALLOC_SIZE (table, request->arena,
+			     256 * sizeof (char *) + start[256] + 256,
+			     const char *))
+	return false;
+      string = (char *) (table + 256);
+
+      for (counter = 0; counter < 256; counter++)
+	{
+	  size_t size = start[counter + 1] - start[counter];
+
+	  table[counter] = string;
+	  memcpy (string, output + start[counter], size);
+	  string += size;
+	  *string++ = NUL;
+	}
+
+      step->step_type = RECODE_BYTE_TO_STRING;
+      step->step_table = table;
+      step->transform_routine = recode_transform_byte_to_variable;
+      step->quality = outer->quality_byte_to_variable;
+    }
+
+  step->term_routine = NULL;
+  step->step_table_term_routine = NULL;
+  return true;
+}
+
+/*---------------------------------------------------------------------.
+| Prepare STEP, a double `iconv' step within REQUEST.  If it merely    |
+| maps bytes to fixed strings, turn it into a table step.  Otherwise,  |
+| give it pools of descriptors.  One descriptor is opened right away,  |
+| so the first task does not pay for it.  If it cannot be opened,      |
+| tasks will report the error.  Return false only if memory is         |
+| exhausted.                                                           |
+`---------------------------------------------------------------------*/
+
 bool
-recode_transform_with_iconv (RECODE_SUBTASK subtask)
+recode_init_iconv (RECODE_STEP step, RECODE_CONST_REQUEST request)
 {
-  RECODE_OUTER outer = subtask->task->request->outer;
-  RECODE_CONST_STEP step = subtask->step;
-  char *tocode = iconv_fix_options (outer, step->after->iconv_name);
+  struct iconv_local *local;
+  const char *tocode = iconv_fix_options (request, step->after->iconv_name);
   const char *fromcode = step->before->iconv_name;
-  iconv_t conversion = (iconv_t) -1;
+  iconv_t conversion;
+
+  if (!tocode)
+    return false;
+
+  conversion = iconv_open (tocode, fromcode);
+  if (conversion != (iconv_t) -1
+      && table_iconv_step (step, request, conversion))
+    {
+      iconv_close (conversion);
+      return true;
+    }
+
+  if (!ARENA_ALLOC (local, request->arena, 1, struct iconv_local))
+    {
+      if (conversion != (iconv_t) -1)
+	iconv_close (conversion);
+      return false;
+    }
+
+  init_pool (&local->conversion, request->outer, tocode, fromcode);
+  init_pool (&local->check, request->outer, fromcode, fromcode);
+  step->local = local;
+  step->term_routine = term_iconv;
+  step->step_table_term_routine = NULL;
+
+  if (conversion != (iconv_t) -1)
+    release_descriptor (&local->conversion, conversion);
+  return true;
+}
+
+bool
+recode_transform_with_iconv (RECODE_SUBTASK subtask)
+{
+  struct iconv_local *local = (struct iconv_local *) subtask->step->local;
+  iconv_t conversion = acquire_descriptor (&local->conversion);
+  bool status;
 
-  if (tocode)
-    conversion = iconv_open (tocode, fromcode);
   if (conversion == (iconv_t) -1)
     {
       recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
-      free (tocode);
       SUBTASK_RETURN (subtask);
     }
 
-  bool status = wrapped_transform (conversion, subtask);
-  iconv_close (conversion);
-  free (tocode);
+  if (BLOCK_INPUT (subtask) && !subtask->output.file)
+    status = transform_block (conversion, subtask);
+  else
+    status = wrapped_transform (conversion, subtask);
+  release_descriptor (&local->conversion, conversion);
   return status;
 }
 
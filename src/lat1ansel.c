@@ -49,14 +49,13 @@ init_latin1_ansel (RECODE_STEP step,
 		   RECODE_CONST_OPTION_LIST before_options _GL_UNUSED,
 		   RECODE_CONST_OPTION_LIST after_options _GL_UNUSED)
 {
-  RECODE_OUTER outer = request->outer;
-  
   char *pool;
   const char **table;
   unsigned counter;
   struct translation const *cursor;
 
-  if (!ALLOC_SIZE (table, 256 * sizeof (char *) + 256, const char *))
+  if (!ARENA_ALLOC_SIZE (table, request->arena,
+			 256 * sizeof (char *) + 256, const char *))
     return false;
   pool = (char *) (table + 256);
 
@@ -72,7 +71,6 @@ init_latin1_ansel (RECODE_STEP step,
     table[cursor->code] = cursor->string;
 
   step->step_table = table;
-  step->step_table_term_routine = free;
 
   return true;
 }
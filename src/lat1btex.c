@@ -133,7 +133,6 @@ init_latin1_bibtex (RECODE_STEP step,
 		   RECODE_CONST_OPTION_LIST before_options,
 		   RECODE_CONST_OPTION_LIST after_options)
 {
-  RECODE_OUTER outer = request->outer;
   char *pool;
   const char **table;
   unsigned counter;
@@ -142,7 +141,8 @@ init_latin1_bibtex (RECODE_STEP step,
   if (before_options || after_options)
     return false;
 
-  if (!ALLOC_SIZE (table, 256 * sizeof (char *) + 256, const char *))
+  if (!ARENA_ALLOC_SIZE (table, request->arena,
+			 256 * sizeof (char *) + 256, const char *))
     return false;
   pool = (char *) (table + 256);
 
@@ -163,7 +163,6 @@ init_latin1_bibtex (RECODE_STEP step,
 
   step->step_type = RECODE_BYTE_TO_STRING;
   step->step_table = table;
-  step->step_table_term_routine = free;
   return true;
 }
 
@@ -160,8 +160,6 @@ init_latin1_texte (RECODE_STEP step,
 		   RECODE_CONST_OPTION_LIST before_options,
 		   RECODE_CONST_OPTION_LIST after_options)
 {
-  RECODE_OUTER outer = request->outer;
-
   unsigned rewritten;		/* number of rewritten translations */
   const char **table;		/* allocated structure, including pool */
   char *pool;			/* cursor in character pool */
@@ -183,8 +181,9 @@ init_latin1_texte (RECODE_STEP step,
 	  && translation_table[counter - 128][2] == NUL)
 	rewritten++;
 
-  if (!ALLOC_SIZE (table, sizeof (char *) * 256 + 2 * 128 + 3 * rewritten,
-		   const char *))
+  if (!ARENA_ALLOC_SIZE (table, request->arena,
+			 sizeof (char *) * 256 + 2 * 128 + 3 * rewritten,
+			 const char *))
     return false;
   pool = (char *) (table + 256);
 
@@ -211,7 +210,6 @@ init_latin1_texte (RECODE_STEP step,
 
   step->step_type = RECODE_BYTE_TO_STRING;
   step->step_table = table;
-  step->step_table_term_routine = free;
   return true;
 }
 
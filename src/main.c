@@ -20,6 +20,7 @@
 #include "common.h"
 
 #include <ctype.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -27,9 +28,15 @@
 #include <utime.h>
 #include <setjmp.h>
 #include <locale.h>
+#include <stdarg.h>
 
 #include "getopt.h"
+#include "minmax.h"
+#include "nproc.h"
 #include "xbinary-io.h"
+
+#include "glthread/lock.h"
+#include "glthread/thread.h"
 
 /* Variables.  */
 
@@ -82,6 +89,9 @@ static bool force_flag = false;
    thus effectively `touching' the file.  */
 static bool touch_option = false;
 
+/* Number of files which may be recoded at once, each by its own thread.  */
+static unsigned jobs = 1;
+
 /* With strict mapping, all recode_reversibility fallbacks get defeated.  */
 static bool strict_mapping = false;
 
@@ -99,14 +109,14 @@ bool decoding_charset_flag = false;
 
 /* Error handling.  */
 
-/*-------------------------------------------------.
-| Produce a message explaining the error in TASK.  |
-`-------------------------------------------------*/
+/*-----------------------------------------------------.
+| Produce a message explaining the ERROR of some task. |
+`-----------------------------------------------------*/
 
 static const char *
-task_perror (RECODE_CONST_TASK task)
+task_perror (enum recode_error error)
 {
-  switch (task->error_so_far)
+  switch (error)
     {
     case RECODE_NO_ERROR:
       return _("No error");
@@ -203,6 +213,7 @@ Operation modes:\n\
   -q, --quiet, --silent   inhibit messages about irreversible recodings\n\
   -f, --force             force recodings even when not reversible\n\
   -t, --touch             touch the recoded files after replacement\n\
+  -j, --jobs=N            recode up to N files at once, 0 for all processors\n\
   -i, -p, --sequence=STRATEGY  ignored for backwards compatibility\n\
 "),
 	     stdout);
@@ -275,6 +286,7 @@ static const struct option long_options[] =
   {"header", optional_argument, NULL, 'h'},
   {"help", no_argument, &show_help, 1},
   {"ignore", required_argument, NULL, 'x'},
+  {"jobs", required_argument, NULL, 'j'},
   {"known", required_argument, NULL, 'k'},
   {"list", optional_argument, NULL, 'l'},
   {"prefer-iconv", no_argument, NULL, 'I'},
@@ -347,6 +359,397 @@ new_request(RECODE_OUTER outer, struct recode_request *request_option)
   return request;
 }
 
+/* Recoding files over themselves.  */
+
+/* Outcome of recoding one file over itself, kept until it gets reported.  */
+
+struct file_outcome
+  {
+    bool done;			/* if the file has been handled at all */
+    char *input_name;		/* real name of the file, or NULL */
+    bool announced;		/* if verbose progress was already shown */
+    bool attempted;		/* if recoding has been tried */
+    bool recoded;		/* if recoding succeeded */
+    enum recode_error error;	/* error met while recoding */
+    RECODE_CONST_STEP error_at_step; /* step where the error was met */
+    char *fatal;		/* system problem stopping everything, or NULL */
+    int fatal_errno;		/* errno value explaining FATAL */
+  };
+
+/*--------------------------------------------------------------------.
+| Save into OUTCOME the current errno and a message built from FORMAT |
+| and its arguments, as a system problem stopping everything.         |
+`--------------------------------------------------------------------*/
+
+static void
+file_fatal (struct file_outcome *outcome, const char *format, ...)
+{
+  va_list args;
+
+  outcome->fatal_errno = errno;
+  va_start (args, format);
+  if (vasprintf (&outcome->fatal, format, args) == -1)
+    xalloc_die ();
+  va_end (args);
+}
+
+/*--------------------------------------------------------------------.
+| Recode file NAME over itself through TASK, saving into OUTCOME what |
+| should be reported about it.  Show progress right away if ANNOUNCE. |
+| No message is otherwise written, so this may run in any thread.     |
+`--------------------------------------------------------------------*/
+
+static void
+recode_file (RECODE_TASK task, bool (*processor) (RECODE_TASK),
+	     const char *name, bool announce, struct file_outcome *outcome)
+{
+  FILE *file;
+  struct stat file_stat;
+  struct utimbuf file_utime;
+  char *input_name;
+
+  outcome->done = true;
+  input_name = realpath (name, NULL);
+  if (input_name == NULL)
+    {
+      file_fatal (outcome, "realpath (%s)", name);
+      return;
+    }
+  outcome->input_name = input_name;
+
+  /* Check if the file can be read and rewritten.  */
+
+  if (file = fopen (input_name, "r+"), file == NULL)
+    {
+      file_fatal (outcome, "fopen (%s)", input_name);
+      return;
+    }
+
+  /* Save the input file attributes.  */
+
+  fstat (fileno (file), &file_stat);
+  fclose (file);
+
+  /* Choose an output file in the same directory.  */
+
+  char *input_name_copy = xstrdup (input_name);
+  char *output_dir = dirname (input_name_copy);
+  char *output_name;
+  if (asprintf (&output_name, "%s/recode-XXXXXX.tmp", output_dir) == -1)
+    xalloc_die ();
+  free (input_name_copy);
+  int fd = mkstemps (output_name, 4);
+  if (fd == -1)
+    {
+      file_fatal (outcome, "mkstemps (%s)", output_name);
+      free (output_name);
+      return;
+    }
+  xset_binary_mode (fd, O_BINARY);
+
+  /* Recode the file, forgetting errors met in previous files.  */
+
+  recode_task_reset (task);
+  task->input.name = input_name;
+  task->output.name = NULL;
+  task->output.file = fdopen (fd, "w+");
+  if (task->output.file == NULL)
+    {
+      file_fatal (outcome, "fdopen ()");
+      free (output_name);
+      return;
+    }
+
+  if (announce)
+    {
+      fprintf (stderr, _("Recoding %s..."), input_name);
+      fflush (stderr);
+      outcome->announced = true;
+    }
+
+  outcome->attempted = true;
+  outcome->recoded = (*processor) (task);
+  outcome->error = task->error_so_far;
+  outcome->error_at_step = task->error_at_step;
+
+  if (outcome->recoded)
+    {
+      /* Close the file. */
+
+      if (fclose (task->output.file) == EOF)
+	file_fatal (outcome, "close ()");
+
+      /* Move the new file over the original.  */
+
+      else if (unlink (input_name) < 0)
+	file_fatal (outcome, "unlink (%s)", input_name);
+
+      else
+	{
+	  /* Preserve the file permissions if possible.  */
+
+	  chmod (output_name, file_stat.st_mode & 07777);
+
+	  if (rename (output_name, input_name) < 0)
+	    file_fatal (outcome, "rename (%s, %s)", output_name, input_name);
+
+	  /* Adjust the time stamp for the new file.  */
+
+	  else if (!touch_option)
+	    {
+	      file_utime.actime = file_stat.st_atime;
+	      file_utime.modtime = file_stat.st_mtime;
+	      utime (input_name, &file_utime);
+	    }
+	}
+    }
+  else
+    {
+      /* Recoding failed, discard output.  */
+
+      fclose (task->output.file);
+      unlink (output_name);
+    }
+  free (output_name);
+}
+
+/*------------------------------------------------------------------.
+| Report OUTCOME for a file, exiting on any system problem.  Return |
+| false if the file could not be recoded.                           |
+`------------------------------------------------------------------*/
+
+static bool
+report_file (const struct file_outcome *outcome)
+{
+  bool success = true;
+
+  if (outcome->attempted)
+    {
+      RECODE_CONST_STEP step = outcome->error_at_step;
+
+      if (verbose_flag && !outcome->announced)
+	{
+	  fprintf (stderr, _("Recoding %s..."), outcome->input_name);
+	  fflush (stderr);
+	}
+
+      if (outcome->recoded)
+	{
+	  /* Recoding was successful.  */
+
+	  if (verbose_flag)
+	    {
+	      fprintf (stderr, _(" done\n"));
+	      fflush (stderr);
+	    }
+	}
+      else
+	{
+	  success = false;
+	  if (verbose_flag)
+	    {
+	      fprintf (stderr, _(" failed: %s%s%s%s%s%s\n"),
+		       task_perror (outcome->error),
+		       step ? _(" in step `") : "",
+		       step ? step->before->name : "",
+		       step ? _("..") : "",
+		       step ? step->after->name : "",
+		       step ? _("'") : "");
+	      fflush (stderr);
+	    }
+	  else if (!quiet_flag)
+	    error (0, 0, _("%s failed: %s%s%s%s%s%s"),
+		   outcome->input_name, task_perror (outcome->error),
+		   step ? _(" in step `") : "",
+		   step ? step->before->name : "",
+		   step ? _("..") : "",
+		   step ? step->after->name : "",
+		   step ? _("'") : "");
+	}
+    }
+
+  if (outcome->fatal)
+    error (EXIT_FAILURE, outcome->fatal_errno, "%s", outcome->fatal);
+
+  return success;
+}
+
+/* Identity of a file, however it is named.  */
+
+struct file_identity
+  {
+    dev_t device;		/* device holding the file */
+    ino_t inode;		/* file number within that device */
+  };
+
+static int
+compare_file_identities (const void *void_first, const void *void_second)
+{
+  const struct file_identity *first
+    = (const struct file_identity *) void_first;
+  const struct file_identity *second
+    = (const struct file_identity *) void_second;
+
+  if (first->device != second->device)
+    return first->device < second->device ? -1 : 1;
+  if (first->inode != second->inode)
+    return first->inode < second->inode ? -1 : 1;
+  return 0;
+}
+
+/*-------------------------------------------------------------------.
+| Tell if some file is named more than once among the COUNT files of |
+| NAMES, maybe through other paths or links.  Files which cannot be  |
+| found are not counted, recoding them fails anyway.                 |
+`-------------------------------------------------------------------*/
+
+static bool
+has_duplicate_files (char *const *names, unsigned count)
+{
+  struct file_identity *identities
+    = xnmalloc (count, sizeof (struct file_identity));
+  unsigned known = 0;
+  unsigned counter;
+  bool found = false;
+
+  for (counter = 0; counter < count; counter++)
+    {
+      struct stat file_stat;
+
+      if (stat (names[counter], &file_stat) == 0)
+	{
+	  identities[known].device = file_stat.st_dev;
+	  identities[known].inode = file_stat.st_ino;
+	  known++;
+	}
+    }
+
+  qsort (identities, known, sizeof (struct file_identity),
+	 compare_file_identities);
+  for (counter = 1; counter < known; counter++)
+    if (compare_file_identities (identities + counter - 1,
+				 identities + counter) == 0)
+      found = true;
+
+  free (identities);
+  return found;
+}
+
+/* Files shared between workers, when recoding many files at once.  */
+
+struct file_queue
+  {
+    RECODE_CONST_REQUEST request; /* request shared by all workers */
+    bool (*processor) (RECODE_TASK); /* how to recode a file */
+    enum recode_error fail_level; /* fail level for each task */
+    char *const *names;		/* names of files to recode */
+    struct file_outcome *outcomes; /* outcome for each file */
+    unsigned count;		/* number of files */
+    unsigned next;		/* index of next file to recode */
+    bool stop;			/* if a system problem stopped everything */
+  };
+
+gl_lock_define_initialized (static, file_queue_lock)
+
+/*------------------------------------------------------------------.
+| Recode files from the queue at VOID_QUEUE, one at a time, through |
+| a task of this worker's own, until none is left, or until some    |
+| system problem stops everything.                                  |
+`------------------------------------------------------------------*/
+
+static void *
+file_worker (void *void_queue)
+{
+  struct file_queue *queue = (struct file_queue *) void_queue;
+  RECODE_TASK task = recode_new_task (queue->request);
+
+  if (!task)
+    xalloc_die ();
+  task->fail_level = queue->fail_level;
+  task->abort_level = queue->fail_level;
+
+  while (true)
+    {
+      struct file_outcome *outcome;
+      unsigned index;
+
+      gl_lock_lock (file_queue_lock);
+      if (queue->stop || queue->next == queue->count)
+	{
+	  gl_lock_unlock (file_queue_lock);
+	  break;
+	}
+      index = queue->next++;
+      gl_lock_unlock (file_queue_lock);
+
+      outcome = queue->outcomes + index;
+      recode_file (task, queue->processor, queue->names[index], false,
+		   outcome);
+      if (outcome->fatal)
+	{
+	  gl_lock_lock (file_queue_lock);
+	  queue->stop = true;
+	  gl_lock_unlock (file_queue_lock);
+	}
+    }
+
+  recode_delete_task (task);
+  return NULL;
+}
+
+/*---------------------------------------------------------------------.
+| Recode COUNT files from NAMES through REQUEST with JOBS workers, and |
+| report outcomes in the order of files once all workers are done.     |
+| Return false if any file could not be recoded.                       |
+`---------------------------------------------------------------------*/
+
+static bool
+recode_files_in_parallel (RECODE_CONST_REQUEST request,
+			  bool (*processor) (RECODE_TASK),
+			  enum recode_error fail_level,
+			  char *const *names, unsigned count)
+{
+  struct file_queue queue;
+  gl_thread_t *threads;
+  unsigned workers = MIN (jobs, count);
+  unsigned counter;
+  bool success = true;
+
+  queue.request = request;
+  queue.processor = processor;
+  queue.fail_level = fail_level;
+  queue.names = names;
+  queue.outcomes = xcalloc (count, sizeof (struct file_outcome));
+  queue.count = count;
+  queue.next = 0;
+  queue.stop = false;
+
+  /* The main thread is one of the workers.  */
+
+  threads = xnmalloc (workers, sizeof (gl_thread_t));
+  for (counter = 1; counter < workers; counter++)
+    threads[counter] = gl_thread_create (file_worker, &queue);
+  file_worker (&queue);
+  for (counter = 1; counter < workers; counter++)
+    gl_thread_join (threads[counter], NULL);
+  free (threads);
+
+  /* Files after a system problem may have been left alone.  */
+
+  for (counter = 0; counter < count && queue.outcomes[counter].done;
+       counter++)
+    {
+      struct file_outcome *outcome = queue.outcomes + counter;
+
+      if (!report_file (outcome))
+	success = false;
+      free (outcome->input_name);
+    }
+  free (queue.outcomes);
+
+  return success;
+}
+
 int
 main (int argc, char *const *argv)
 {
@@ -381,7 +784,7 @@ main (int argc, char *const *argv)
   task_option.fail_level = RECODE_AMBIGUOUS_OUTPUT;
   task_option.abort_level = RECODE_AMBIGUOUS_OUTPUT;
 
-  while (option_char = getopt_long (argc, argv, "CIFS::Tcdfgh::ik:l::pqstvx:",
+  while (option_char = getopt_long (argc, argv, "CIFS::Tcdfgh::ij:k:l::pqstvx:",
 				    long_options, NULL),
 	 option_char != -1)
     switch (option_char)
@@ -520,6 +923,23 @@ main (int argc, char *const *argv)
         /* Ignore for backwards compatibility with version 3.6.  */
 	break;
 
+      case 'j':
+	{
+	  char *end;
+	  unsigned long value;
+
+	  errno = 0;
+	  value = strtoul (optarg, &end, 10);
+	  if (errno || end == optarg || *end || value > UINT_MAX
+	      || !isdigit ((unsigned char) *optarg))
+	    {
+	      error (0, 0, _("Jobs `%s' is invalid"), optarg);
+	      usage (EXIT_FAILURE, 0);
+	    }
+	  jobs = value ? value : num_processors (NPROC_CURRENT_OVERRIDABLE);
+	}
+	break;
+
       case 'k':
 	charset_restrictions = optarg;
 	break;
@@ -764,123 +1184,36 @@ warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n"),
 	   recoding step at all, do not even try to touch the files.  */
 
 	if (request->sequence_length > 0)
+	  {
+	    /* A file named more than once gets recoded again and again, each
+	       time over the previous result, so it needs files to be taken
+	       one at a time.  */
 
-	  /* Process files, one at a time.  */
-
-	  for (; optind < argc; optind++)
-	    {
-	      const char *input_name;
-	      FILE *file;
-	      struct stat file_stat;
-	      struct utimbuf file_utime;
-
-	      input_name = realpath (argv[optind], NULL);
-	      if (input_name == NULL)
-		error (EXIT_FAILURE, errno, "realpath (%s)", argv[optind]);
-
-	      /* Check if the file can be read and rewritten.  */
-
-	      if (file = fopen (input_name, "r+"), file == NULL)
-		error (EXIT_FAILURE, errno, "fopen (%s)", input_name);
-
-	      /* Save the input file attributes.  */
-
-	      fstat (fileno (file), &file_stat);
-	      fclose (file);
-
-	      /* Choose an output file in the same directory.  */
-
-	      char *input_name_copy = xstrdup (input_name);
-	      char *output_dir = dirname (input_name_copy);
-	      char *output_name;
-	      if (asprintf (&output_name, "%s/recode-XXXXXX.tmp", output_dir) == -1)
-		error (EXIT_FAILURE, errno, "asprintf");
-	      int fd = mkstemps (output_name, 4);
-	      if (fd == -1)
-		error (EXIT_FAILURE, errno, "mkstemps (%s)", output_name);
-	      xset_binary_mode (fd, O_BINARY);
-
-	      /* Recode the file.  */
-
-	      task->input.name = input_name;
-	      task->output.name = NULL;
-	      task->output.file = fdopen (fd, "w+");
-	      if (task->output.file == NULL)
-	      	error (EXIT_FAILURE, errno, "fdopen ()");
-
-	      if (verbose_flag)
-		{
-		  fprintf (stderr, _("Recoding %s..."), task->input.name);
-		  fflush (stderr);
-		}
-
-	      if ((*processor) (task))
-		{
-		  /* Recoding was successful.  */
-
-		  if (verbose_flag)
-		    {
-		      fprintf (stderr, _(" done\n"));
-		      fflush (stderr);
-		    }
-
-                  /* Close the file. */
-
-                  if (fclose (task->output.file) == EOF)
-                    error (EXIT_FAILURE, errno, "close ()");
-
-		  /* Move the new file over the original.  */
-
-		  if (unlink (input_name) < 0)
-		    error (EXIT_FAILURE, errno, "unlink (%s)", input_name);
-
-		  /* Preserve the file permissions if possible.  */
+	    if (jobs > 1 && argc - optind > 1
+		&& !has_duplicate_files (argv + optind, argc - optind))
 
-		  chmod (output_name, file_stat.st_mode & 07777);
+	      /* Process files, many at once.  */
 
-		  if (rename (output_name, input_name) < 0)
-		    error (EXIT_FAILURE, errno, "rename (%s, %s)",
-			   output_name, input_name);
+	      success = recode_files_in_parallel (request, processor,
+						  task_option.fail_level,
+						  argv + optind,
+						  argc - optind);
+	    else
 
-		  /* Adjust the time stamp for the new file.  */
+	      /* Process files, one at a time.  */
 
-		  if (!touch_option)
-		    {
-		      file_utime.actime = file_stat.st_atime;
-		      file_utime.modtime = file_stat.st_mtime;
-		      utime (input_name, &file_utime);
-		    }
-		}
-	      else
+	      for (; optind < argc; optind++)
 		{
-		  /* Recoding failed, discard output.  */
-
-		  success = false;
-		  if (verbose_flag)
-		    {
-		      fprintf (stderr, _(" failed: %s%s%s%s%s%s\n"),
-			       task_perror (task),
-                               task->error_at_step ? _(" in step `") : "",
-			       task->error_at_step ? task->error_at_step->before->name : "",
-                               task->error_at_step ? _("..") : "",
-			       task->error_at_step ? task->error_at_step->after->name : "",
-                               task->error_at_step ? _("'") : "");
-		      fflush (stderr);
-		    }
-		  else if (!quiet_flag)
-		    error (0, 0, _("%s failed: %s%s%s%s%s%s"),
-			   input_name, task_perror (task),
-                           task->error_at_step ? _(" in step `") : "",
-                           task->error_at_step ? task->error_at_step->before->name : "",
-                           task->error_at_step ? _("..") : "",
-                           task->error_at_step ? task->error_at_step->after->name : "",
-                           task->error_at_step ? _("'") : "");
-
-		  unlink (output_name);
+		  struct file_outcome outcome;
+
+		  memset (&outcome, 0, sizeof (struct file_outcome));
+		  recode_file (task, processor, argv[optind], verbose_flag,
+			       &outcome);
+		  if (!report_file (&outcome))
+		    success = false;
+		  free (outcome.input_name);
 		}
-	      free (output_name);
-	      free (input_name_copy);
-	    }
+	  }
       }
     else
       {
@@ -891,7 +1224,7 @@ warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n"),
 	    success = false;
 	    if (!quiet_flag)
 	      error (0, 0, _("%s%s%s%s%s%s"),
-		     task_perror (task),
+		     task_perror (task->error_so_far),
                      task->error_at_step ? _(" in step `") : "",
                      task->error_at_step ? task->error_at_step->before->name : "",
                      task->error_at_step ? _("..") : "",
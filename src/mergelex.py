@@ -17,7 +17,7 @@
 # along with this program; if not, see <https://www.gnu.org/licenses/>.
 
 # This Python script merges several Flex sources intended for Recode.
-# It requires Flex 2.5 or later.
+# It requires Flex 2.5.34 or later, for reentrant scanners.
 
 import re, sys
 
@@ -30,22 +30,25 @@ section1 = '''\
 
 %option nounput
 %option noyywrap
+%option reentrant
+%option extra-type="RECODE_SUBTASK"
 %{
 #include "common.h"
-static RECODE_CONST_REQUEST request;
-static RECODE_SUBTASK subtask;
 
 #define YY_INPUT(buf, result, max_size) \
   { \
-    int c = recode_get_byte (subtask); \
-    result = (c == EOF) ? YY_NULL : (buf[0] = c, 1); \
+    size_t size = recode_get_bytes (yyextra, buf, max_size); \
+    result = size == 0 ? YY_NULL : size; \
   }
 %}
 '''.splitlines(True)
 
-# Flex rules.
+# Flex rules.  The scanner state is private to each task, so the task
+# variables are local to the scanning routine.
 section2 = '''\
 %%
+			RECODE_SUBTASK subtask = yyextra;
+			RECODE_CONST_REQUEST request = subtask->task->request;
 <<EOF>>			{ return 1; }
 '''.splitlines(True)
 
@@ -72,15 +75,21 @@ while True:
         section3.append('''\
 
 static bool
-transform_%s (RECODE_SUBTASK subtask_argument)
+transform_%s (RECODE_SUBTASK subtask)
 {
-  subtask = subtask_argument;
-  request = subtask->task->request;
-  yy_init = 0;
-  yyin = subtask->input.file;
-  yyout = subtask->output.file;
+  yyscan_t yyscanner;
+  struct yyguts_t *yyg;
+
+  if (yylex_init_extra (subtask, &yyscanner) != 0)
+    {
+      recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
+      SUBTASK_RETURN (subtask);
+    }
+  yyg = (struct yyguts_t *) yyscanner;
   BEGIN %s;
-  return yylex ();
+  yylex (yyscanner);
+  yylex_destroy (yyscanner);
+  SUBTASK_RETURN (subtask);
 }
 '''
             % (step_name, step_name))
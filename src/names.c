@@ -102,18 +102,20 @@ alias_comparator (const void *void_first, const void *void_second)
   return strcmp (first->name, second->name) == 0;
 }
 
-static void
-alias_free (void *void_alias)
+static bool
+alias_free (void *void_alias, void *void_outer)
 {
   RECODE_ALIAS alias = (RECODE_ALIAS) void_alias;
+  RECODE_OUTER outer = (RECODE_OUTER) void_outer;
   struct recode_surface_list *list, *next;
 
   for (list = alias->implied_surfaces; list; list = next)
     {
       next = list->next;
-      free (list);
+      recode_free (outer, list);
     }
-  free (alias);
+  recode_free (outer, alias);
+  return true;
 }
 
 bool
@@ -122,14 +124,29 @@ recode_prepare_for_aliases (RECODE_OUTER outer)
   outer->symbol_list = NULL;
   outer->number_of_symbols = 0;
 
+  /* Aliases are freed by recode_delete_aliases, not by the hash table, as
+     this needs OUTER for reaching the allocator.  */
+
   outer->alias_table
-    = hash_initialize (800, NULL, alias_hasher, alias_comparator, alias_free);
+    = hash_initialize (800, NULL, alias_hasher, alias_comparator, NULL);
   if (!outer->alias_table)
     return false;
 
   return true;
 }
 
+/*-------------------------------------------------------.
+| Free the table of all aliases, and all aliases in it.  |
+`-------------------------------------------------------*/
+
+void
+recode_delete_aliases (RECODE_OUTER outer)
+{
+  hash_do_for_each ((Hash_table *) outer->alias_table, alias_free, outer);
+  hash_free ((Hash_table *) outer->alias_table);
+  outer->alias_table = NULL;
+}
+
 /*---------------------------------------------------------------------------.
 | Return a newly allocated copy of symbol NAME, with upper case letters      |
 | turned into lower case, and all non alphanumeric discarded, or NULL if any |
@@ -161,20 +178,96 @@ name_for_argmatch (RECODE_OUTER outer, const char *name)
   return result;
 }
 
+/*-------------------------------------------------------------------------.
+| Return the next character of NAME that name_for_argmatch would keep, in  |
+| lower case, advancing *CURSOR past it, or NUL at the end of NAME.        |
+`-------------------------------------------------------------------------*/
+
+static int
+next_argmatch_character (const char **cursor)
+{
+  while (**cursor)
+    {
+      int character = *(const unsigned char *) (*cursor)++;
+
+      if ((character >= 'a' && character <= 'z')
+	  || (character >= '0' && character <= '9'))
+	return character;
+      if (character >= 'A' && character <= 'Z')
+	return character - 'A' + 'a';
+    }
+  return NUL;
+}
+
+/*-----------------------------------------------------------------------.
+| Compare NAME, as name_for_argmatch would rewrite it, with KEY, which   |
+| already is.  When PREFIX, also return zero if NAME is a prefix of KEY. |
+`-----------------------------------------------------------------------*/
+
+static int
+compare_argmatch_name (const char *name, const char *key, bool prefix)
+{
+  while (true)
+    {
+      int character = next_argmatch_character (&name);
+
+      if (!character && prefix)
+	return 0;
+      if (character != *(const unsigned char *) key)
+	return character - *(const unsigned char *) key;
+      if (!character)
+	return 0;
+      key++;
+    }
+}
+
+/*------------------------------------------------------------------------.
+| Return the alias for NAME within the COUNT sorted normalized KEYS, with |
+| their ALIASES, or NULL.  NAME is looked up as argmatch would: an exact  |
+| match wins, otherwise NAME should be a prefix of a single key.  Keys    |
+| having NAME as a prefix are contiguous, and start where NAME would go.  |
+`------------------------------------------------------------------------*/
+
+static RECODE_ALIAS
+find_argmatch_alias (const char *name, const char *const *keys,
+		     RECODE_ALIAS const *aliases, unsigned count)
+{
+  unsigned first = 0;
+  unsigned last = count;
+
+  while (first < last)
+    {
+      unsigned middle = (first + last) / 2;
+
+      if (compare_argmatch_name (name, keys[middle], false) > 0)
+	first = middle + 1;
+      else
+	last = middle;
+    }
+
+  if (first == count)
+    return NULL;
+  if (compare_argmatch_name (name, keys[first], false) == 0)
+    return aliases[first];
+  if (compare_argmatch_name (name, keys[first], true) == 0
+      && (first + 1 == count
+	  || compare_argmatch_name (name, keys[first + 1], true) != 0))
+    return aliases[first];
+  return NULL;
+}
+
 /*---------------------------------------------------------------------------.
-| Given an abbreviated NAME of a charset or surface, return its full name,   |
-| properly capitalized and punctuated, or NULL if this cannot be done        |
-| successfully.  FIND_TYPE may restrict the interpretation.  A NULL or empty |
-| string means the default charset, if this default charset is defined.      |
+| Given an abbreviated NAME of a charset or surface, return its alias, or    |
+| NULL if this cannot be done successfully.  FIND_TYPE may restrict the      |
+| interpretation.  A NULL or empty string means the default charset, if this |
+| default charset is defined.                                                |
 `---------------------------------------------------------------------------*/
 
-static const char *
+static RECODE_ALIAS
 disambiguate_name (RECODE_OUTER outer,
 		   const char *name, enum alias_find_type find_type)
 {
-  char *hashname;
-  int ordinal;
-  const char *result;
+  RECODE_ALIAS result;
 
   result = NULL;		/* for lint */
 
@@ -196,10 +289,6 @@ disambiguate_name (RECODE_OUTER outer,
 	return NULL;
       }
 
-  hashname = name_for_argmatch (outer, name);
-  if (!hashname)
-    return NULL;
-
   switch (find_type)
     {
     case SYMBOL_CREATE_CHARSET:
@@ -207,31 +296,31 @@ disambiguate_name (RECODE_OUTER outer,
       abort ();
 
     case ALIAS_FIND_AS_CHARSET:
-      ordinal = argmatch (hashname, outer->argmatch_charset_array, NULL, 0);
-      result = ordinal < 0 ? NULL : outer->realname_charset_array[ordinal];
+      result = find_argmatch_alias (name, outer->argmatch_charset_array,
+				    outer->charset_alias_array,
+				    outer->argmatch_charset_count);
       break;
 
     case ALIAS_FIND_AS_SURFACE:
-      ordinal = argmatch (hashname, outer->argmatch_surface_array, NULL, 0);
-      result = ordinal < 0 ? NULL : outer->realname_surface_array[ordinal];
+      result = find_argmatch_alias (name, outer->argmatch_surface_array,
+				    outer->surface_alias_array,
+				    outer->argmatch_surface_count);
       break;
 
     case ALIAS_FIND_AS_EITHER:
-      ordinal = argmatch (hashname, outer->argmatch_charset_array, NULL, 0);
-      if (ordinal >= 0)
-	result = outer->realname_charset_array[ordinal];
-      else
-	{
-	  ordinal = argmatch (hashname, outer->argmatch_surface_array, NULL, 0);
-	  result = ordinal < 0 ? NULL : outer->realname_surface_array[ordinal];
-	}
+      result = find_argmatch_alias (name, outer->argmatch_charset_array,
+				    outer->charset_alias_array,
+				    outer->argmatch_charset_count);
+      if (!result)
+	result = find_argmatch_alias (name, outer->argmatch_surface_array,
+				      outer->surface_alias_array,
+				      outer->argmatch_surface_count);
       break;
 
     default:
       break;
     }
 
-  free (hashname);
   return result;
 }
 
@@ -240,10 +329,10 @@ disambiguate_name (RECODE_OUTER outer,
 `----------------------------------------------------------------------------*/
 
 void
-recode_delete_alias (RECODE_ALIAS alias)
+recode_delete_alias (RECODE_OUTER outer, RECODE_ALIAS alias)
 {
-  free (alias->symbol);
-  free (alias);
+  recode_free (outer, alias->symbol);
+  recode_free (outer, alias);
 }
 
 /*----------------------------------------------------------------------------.
@@ -274,11 +363,9 @@ recode_find_alias (RECODE_OUTER outer, const char *name,
       break;
 
     default:
-      /* Clean and disambiguate first as requested.  */
+      /* Clean and disambiguate as requested.  */
 
-      name = disambiguate_name (outer, name, find_type);
-      if (!name)
-	return NULL;
+      return disambiguate_name (outer, name, find_type);
     }
 
   /* Search the whole hash bucket and return any match.  */
@@ -308,7 +395,7 @@ recode_find_alias (RECODE_OUTER outer, const char *name,
 
   if (!ALLOC (alias, 1, struct recode_alias))
     {
-      free (symbol);
+      recode_free (outer, symbol);
       return NULL;
     }
   alias->name = name;
@@ -316,7 +403,7 @@ recode_find_alias (RECODE_OUTER outer, const char *name,
   alias->implied_surfaces = NULL;
   if (!hash_insert ((Hash_table *) outer->alias_table, alias))
     {
-      recode_delete_alias (alias);
+      recode_delete_alias (outer, alias);
       return NULL;
     }
 
@@ -364,7 +451,7 @@ recode_declare_alias (RECODE_OUTER outer, const char *name, const char *old_name
   alias->implied_surfaces = NULL;
   if (!hash_insert ((Hash_table *) outer->alias_table, alias))
     {
-      free (alias);
+      recode_free (outer, alias);
       return NULL;
     }
 
@@ -402,15 +489,24 @@ recode_declare_implied_surface (RECODE_OUTER outer, RECODE_ALIAS alias,
   return true;
 }
 
-/*-------------------------------------------.
-| Construct the string arrays for argmatch.  |
-`-------------------------------------------*/
+/*------------------------------------------------------------------------.
+| Construct the sorted arrays of normalized names, and of their aliases.  |
+`------------------------------------------------------------------------*/
+
+struct argmatch_entry
+  {
+    const char *name;		/* normalized name */
+    RECODE_ALIAS alias;		/* alias for this name */
+    unsigned order;		/* rank in the walk of the alias table */
+  };
 
 struct make_argmatch_walk
   {
     RECODE_OUTER outer;
     unsigned charset_counter;	/* number of acceptable charset names */
     unsigned surface_counter;	/* number of acceptable surface names */
+    struct argmatch_entry *charset_entries; /* entries for charsets */
+    struct argmatch_entry *surface_entries; /* entries for surfaces */
   };
 
 static bool
@@ -433,35 +529,67 @@ make_argmatch_walker_2 (void *void_alias, void *void_walk)
   RECODE_ALIAS alias = (RECODE_ALIAS) void_alias;
   struct make_argmatch_walk *walk = (struct make_argmatch_walk *) void_walk;
   RECODE_OUTER outer = walk->outer;
+  struct argmatch_entry *entry;
+  char *string = name_for_argmatch (outer, alias->name);
+
+  if (!string)
+    abort ();
 
   if (alias->symbol->type == RECODE_CHARSET)
     {
-      char *string = name_for_argmatch (outer, alias->name);
-
-      if (!string)
-	abort ();
-      outer->argmatch_charset_array[walk->charset_counter] = string;
-      outer->realname_charset_array[walk->charset_counter] = alias->name;
-      walk->charset_counter++;
+      entry = walk->charset_entries + walk->charset_counter;
+      entry->order = walk->charset_counter++;
     }
   else
     {
-      char *string = name_for_argmatch (outer, alias->name);
-
-      if (!string)
-	abort ();
-      outer->argmatch_surface_array[walk->surface_counter] = string;
-      outer->realname_surface_array[walk->surface_counter] = alias->name;
-      walk->surface_counter++;
+      entry = walk->surface_entries + walk->surface_counter;
+      entry->order = walk->surface_counter++;
     }
+  entry->name = string;
+  entry->alias = alias;
 
   return true;
 }
 
+/* Equal names keep the order of the walk, so the first one still wins an
+   exact match, as it did with argmatch.  */
+
+static int
+compare_argmatch_entry (const void *void_first, const void *void_second)
+{
+  const struct argmatch_entry *first
+    = (const struct argmatch_entry *) void_first;
+  const struct argmatch_entry *second
+    = (const struct argmatch_entry *) void_second;
+  int value = strcmp (first->name, second->name);
+
+  if (value)
+    return value;
+  return first->order < second->order ? -1 : first->order > second->order;
+}
+
+/* Sort COUNT ENTRIES, then spread them into NAMES and ALIASES.  */
+
+static void
+sort_argmatch_entries (struct argmatch_entry *entries, unsigned count,
+		       const char **names, RECODE_ALIAS *aliases)
+{
+  unsigned counter;
+
+  qsort (entries, count, sizeof (struct argmatch_entry),
+	 compare_argmatch_entry);
+  for (counter = 0; counter < count; counter++)
+    {
+      names[counter] = entries[counter].name;
+      aliases[counter] = entries[counter].alias;
+    }
+}
+
 bool
 recode_make_argmatch_arrays (RECODE_OUTER outer)
 {
   struct make_argmatch_walk walk; /* wanderer's data */
+  struct argmatch_entry *entries;
 
   /* It may happen that new modules are added only once all initialisation
      completed.  To handle that case, free previous arrays if any.  */
@@ -471,10 +599,12 @@ recode_make_argmatch_arrays (RECODE_OUTER outer)
       const char **cursor;
 
       for (cursor = outer->argmatch_charset_array; *cursor; cursor++)
-	free ((char *) *cursor);
+	recode_free (outer, (char *) *cursor);
       for (cursor = outer->argmatch_surface_array; *cursor; cursor++)
-	free ((char *) *cursor);
-      free (outer->argmatch_charset_array);
+	recode_free (outer, (char *) *cursor);
+      recode_free (outer, outer->argmatch_charset_array);
+      recode_free (outer, outer->charset_alias_array);
+      outer->argmatch_charset_array = NULL;
     }
 
   /* Count how many strings we need.  */
@@ -485,14 +615,29 @@ recode_make_argmatch_arrays (RECODE_OUTER outer)
   hash_do_for_each ((Hash_table *) outer->alias_table,
 	 	    make_argmatch_walker_1, &walk);
 
-  /* Allocate the argmatch and realname arrays, each with a NULL sentinel.  */
+  /* Allocate the name and alias arrays, each with a NULL sentinel.  */
+
+  if (!ALLOC (entries, walk.charset_counter + walk.surface_counter,
+	      struct argmatch_entry))
+    return false;
 
   {
     const char **cursor;
+    RECODE_ALIAS *alias_cursor;
 
-    if (!ALLOC (cursor, 2*walk.charset_counter + 2*walk.surface_counter + 4,
+    if (!ALLOC (cursor, walk.charset_counter + walk.surface_counter + 2,
 		const char *))
-      return false;
+      {
+	recode_free (outer, entries);
+	return false;
+      }
+    if (!ALLOC (alias_cursor, walk.charset_counter + walk.surface_counter + 2,
+		RECODE_ALIAS))
+      {
+	recode_free (outer, cursor);
+	recode_free (outer, entries);
+	return false;
+      }
 
     outer->argmatch_charset_array = cursor;
     cursor += walk.charset_counter;
@@ -500,24 +645,36 @@ recode_make_argmatch_arrays (RECODE_OUTER outer)
 
     outer->argmatch_surface_array = cursor;
     cursor += walk.surface_counter;
-    *cursor++ = NULL;
+    *cursor = NULL;
 
-    outer->realname_charset_array = (const char **) cursor;
-    cursor += walk.charset_counter;
-    *cursor++ = NULL;
+    outer->charset_alias_array = alias_cursor;
+    alias_cursor += walk.charset_counter;
+    *alias_cursor++ = NULL;
 
-    outer->realname_surface_array = (const char **) cursor;
-    cursor += walk.surface_counter;
-    *cursor = NULL;
+    outer->surface_alias_array = alias_cursor;
+    alias_cursor += walk.surface_counter;
+    *alias_cursor = NULL;
   }
 
-  /* Fill in the arrays.  */
+  /* Fill in the arrays, sorted by normalized name.  */
 
+  walk.charset_entries = entries;
+  walk.surface_entries = entries + walk.charset_counter;
   walk.charset_counter = 0;
   walk.surface_counter = 0;
   hash_do_for_each ((Hash_table *) outer->alias_table,
 	 	    make_argmatch_walker_2, &walk);
 
+  sort_argmatch_entries (walk.charset_entries, walk.charset_counter,
+			 outer->argmatch_charset_array,
+			 outer->charset_alias_array);
+  sort_argmatch_entries (walk.surface_entries, walk.surface_counter,
+			 outer->argmatch_surface_array,
+			 outer->surface_alias_array);
+  outer->argmatch_charset_count = walk.charset_counter;
+  outer->argmatch_surface_count = walk.surface_counter;
+
+  recode_free (outer, entries);
   return true;
 }
 
@@ -731,7 +888,7 @@ recode_list_all_symbols (RECODE_OUTER outer, RECODE_CONST_SYMBOL after)
 
   /* Release the work array.  */
 
-  free (walk.array);
+  recode_free (outer, walk.array);
   return true;
 }
 
@@ -932,6 +1089,7 @@ static void
 list_full_charset_line (int code, recode_ucs2 ucs2, bool french)
 {
   const char *mnemonic = recode_ucs2_to_rfc1345 (ucs2);
+  char buffer[RECODE_CHARNAME_SIZE];
   const char *charname;
 
   if (code >= 0)
@@ -948,15 +1106,15 @@ list_full_charset_line (int code, recode_ucs2 ucs2, bool french)
 
   if (french)
     {
-      charname = recode_ucs2_to_french_charname (ucs2);
+      charname = recode_ucs2_to_french_charname_r (ucs2, buffer);
       if (!charname)
-	charname = recode_ucs2_to_charname (ucs2);
+	charname = recode_ucs2_to_charname_r (ucs2, buffer);
     }
   else
     {
-      charname = recode_ucs2_to_charname (ucs2);
+      charname = recode_ucs2_to_charname_r (ucs2, buffer);
       if (!charname)
-	charname = recode_ucs2_to_french_charname (ucs2);
+	charname = recode_ucs2_to_french_charname_r (ucs2, buffer);
     }
 
   if (charname)
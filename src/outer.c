@@ -19,7 +19,6 @@
 
 #include "config.h"
 #include "common.h"
-#include "hash.h"
 
 /*-----------------------------------------------------------------------.
 | This dummy fallback routine is used to flag the intent of a reversible |
@@ -97,11 +96,11 @@ recode_declare_single (RECODE_OUTER outer,
   if (!single->before || !single->after)
     {
       if (before)
-        recode_delete_alias (before);
+        recode_delete_alias (outer, before);
       if (after)
-        recode_delete_alias (after);
+        recode_delete_alias (outer, after);
       outer->single_list = single->next;
-      free (single);
+      recode_free (outer, single);
       return NULL;
     }
 
@@ -460,10 +459,47 @@ unregister_all_modules (RECODE_OUTER outer)
 | GLOBAL level functions.  |
 `-------------------------*/
 
+/* Default allocation routines, merely using the C library.  */
+
+static void *
+default_allocate (_GL_UNUSED void *closure, size_t size)
+{
+  return malloc (size);
+}
+
+static void *
+default_reallocate (_GL_UNUSED void *closure, void *pointer, size_t size)
+{
+  return realloc (pointer, size);
+}
+
+static void
+default_release (_GL_UNUSED void *closure, void *pointer)
+{
+  free (pointer);
+}
+
+static const struct recode_allocator default_allocator =
+  {
+    default_allocate,
+    default_reallocate,
+    default_release,
+    NULL
+  };
+
 RECODE_OUTER
 recode_new_outer (unsigned flags)
 {
-  RECODE_OUTER outer = (RECODE_OUTER) calloc (1, sizeof (struct recode_outer));
+  return recode_new_outer_with_allocator (flags, &default_allocator);
+}
+
+RECODE_OUTER
+recode_new_outer_with_allocator (unsigned flags,
+				 const struct recode_allocator *allocator)
+{
+  RECODE_OUTER outer
+    = (RECODE_OUTER) (*allocator->allocate) (allocator->closure,
+					     sizeof (struct recode_outer));
 
   if (!outer)
     {
@@ -472,6 +508,8 @@ recode_new_outer (unsigned flags)
 	exit (1);
       return NULL;
     }
+  memset (outer, 0, sizeof (struct recode_outer));
+  outer->allocator = *allocator;
 
   outer->auto_abort = (flags & RECODE_AUTO_ABORT_FLAG) != 0;
   outer->use_iconv = (flags & RECODE_NO_ICONV_FLAG) == 0;
@@ -523,6 +561,8 @@ recode_new_outer (unsigned flags)
 bool
 recode_delete_outer (RECODE_OUTER outer)
 {
+  struct recode_allocator allocator = outer->allocator;
+
   unregister_all_modules (outer);
   while (outer->number_of_symbols > 0)
     {
@@ -530,7 +570,7 @@ recode_delete_outer (RECODE_OUTER outer)
 
       outer->symbol_list = symbol->next;
       outer->number_of_symbols--;
-      free (symbol);
+      recode_free (outer, symbol);
     }
   while (outer->number_of_singles > 0)
     {
@@ -538,22 +578,23 @@ recode_delete_outer (RECODE_OUTER outer)
 
       outer->single_list = single->next;
       outer->number_of_singles--;
-      free (single);
+      recode_free (outer, single);
     }
-  free (outer->pair_restriction);
+  recode_free (outer, outer->pair_restriction);
   if (outer->alias_table)
-    hash_free ((Hash_table *) outer->alias_table);
+    recode_delete_aliases (outer);
   if (outer->argmatch_charset_array)
     {
       const char **cursor;
 
       for (cursor = outer->argmatch_charset_array; *cursor; cursor++)
-        free ((char *) *cursor);
+        recode_free (outer, (char *) *cursor);
       for (cursor = outer->argmatch_surface_array; *cursor; cursor++)
-        free ((char *) *cursor);
-      free (outer->argmatch_charset_array);
+        recode_free (outer, (char *) *cursor);
+      recode_free (outer, outer->argmatch_charset_array);
+      recode_free (outer, outer->charset_alias_array);
     }
-  free ((void *) outer->one_to_same);
-  free (outer);
+  recode_free (outer, (void *) outer->one_to_same);
+  (*allocator.release) (allocator.closure, outer);
   return true;
 }
@@ -21,12 +21,71 @@
 #include "common.h"
 #include "decsteps.h"
 
+#include "minmax.h"
+
+/*--------------------------------------------------------------------.
+| Copy SIZE bytes from FROM to TO, swapping bytes within each pair.   |
+| SIZE should be even.  This also serves for normalizing UCS-2 input. |
+`--------------------------------------------------------------------*/
+
+void
+recode_swap_pairs (char *to, const char *from, size_t size)
+{
+  size_t counter;
+
+  for (counter = 0; counter < size; counter += 2)
+    {
+      to[counter] = from[counter + 1];
+      to[counter + 1] = from[counter];
+    }
+}
+
+/*-------------------------------------------------------------------------.
+| Reverse the order of bytes within each complete unit of WIDTH bytes, for |
+| the in-memory input of SUBTASK.  WIDTH is either 2 or 4.  An incomplete  |
+| unit at the end is left in the input, for the byte path to handle.       |
+`-------------------------------------------------------------------------*/
+
+static void
+permute_block (RECODE_SUBTASK subtask, unsigned width)
+{
+  const char *cursor = subtask->input.cursor;
+  size_t size = (subtask->input.limit - cursor) / width * width;
+  char buffer[BUFSIZ];
+
+  while (size > 0)
+    {
+      size_t chunk = MIN (size, sizeof buffer / width * width);
+      size_t counter;
+
+      if (width == 2)
+	recode_swap_pairs (buffer, cursor, chunk);
+      else
+	for (counter = 0; counter < chunk; counter += 4)
+	  {
+	    buffer[counter] = cursor[counter + 3];
+	    buffer[counter + 1] = cursor[counter + 2];
+	    buffer[counter + 2] = cursor[counter + 1];
+	    buffer[counter + 3] = cursor[counter];
+	  }
+
+      recode_put_bytes (buffer, chunk, subtask);
+      cursor += chunk;
+      size -= chunk;
+    }
+
+  subtask->input.cursor = cursor;
+}
+
 static bool
 permute_21 (RECODE_SUBTASK subtask)
 {
   int character1;
   int character2;
 
+  if (BLOCK_INPUT (subtask))
+    permute_block (subtask, 2);
+
   while (true)
     {
       character1 = recode_get_byte (subtask);
@@ -55,6 +114,9 @@ permute_4321 (RECODE_SUBTASK subtask)
   int character3;
   int character4;
 
+  if (BLOCK_INPUT (subtask))
+    permute_block (subtask, 4);
+
   while (true)
     {
       character1 = recode_get_byte (subtask);
@@ -21,6 +21,8 @@
 #include "common.h"
 #include "decsteps.h"
 
+#include "minmax.h"
+
 static const bool bitnet_flag = false;
 
 /* Maximum number of characters per MIME line.  */
@@ -82,8 +84,33 @@ transform_data_quoted_printable (RECODE_SUBTASK subtask)
 
       if (available > 1)
 	{
-	  recode_put_byte (character, subtask);
-	  available--;
+	  if (BLOCK_INPUT (subtask))
+	    {
+	      /* Copy the whole run of safe characters which fits on the
+		 line at once, starting with the one already read.  Spaces
+		 not ending a line need no quoting either.  */
+
+	      const char *start = subtask->input.cursor - 1;
+	      const char *limit
+		= start + MIN (available - 1,
+			       (size_t) (subtask->input.limit - start));
+	      const char *cursor = start + 1;
+
+	      while (cursor < limit
+		     && ((!(*cursor & (1 << 7)) && safe_char[(int) *cursor])
+			 || ((*cursor == ' ' || *cursor == '\t')
+			     && cursor + 1 < subtask->input.limit
+			     && cursor[1] != '\n')))
+		cursor++;
+	      recode_put_bytes (start, cursor - start, subtask);
+	      available -= cursor - start;
+	      subtask->input.cursor = cursor;
+	    }
+	  else
+	    {
+	      recode_put_byte (character, subtask);
+	      available--;
+	    }
 	  character = recode_get_byte (subtask);
 	}
       else
@@ -336,6 +363,28 @@ transform_quoted_printable_data (RECODE_SUBTASK subtask)
 	counter++;
 	if (character & (1 << 7) || !safe_char[character])
 	  RETURN_IF_NOGO (RECODE_INVALID_INPUT, subtask);
+	else if (BLOCK_INPUT (subtask))
+	  {
+	    /* Copy the whole run of safe characters at once, starting with
+	       the one already read.  Single spaces between safe characters
+	       are part of the run.  */
+
+	    const char *start = subtask->input.cursor - 1;
+	    const char *run_end = start + 1;
+
+	    while (run_end < subtask->input.limit
+		   && ((!(*run_end & (1 << 7)) && safe_char[(int) *run_end])
+		       || ((*run_end == ' ' || *run_end == '\t')
+			   && run_end + 1 < subtask->input.limit
+			   && !(run_end[1] & (1 << 7))
+			   && safe_char[(int) run_end[1]])))
+	      run_end++;
+	    recode_put_bytes (start, run_end - start, subtask);
+	    counter += run_end - start - 1;
+	    subtask->input.cursor = run_end;
+	    character = recode_get_byte (subtask);
+	    break;
+	  }
 	recode_put_byte (character, subtask);
 	character = recode_get_byte (subtask);
       }
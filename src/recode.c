@@ -59,13 +59,21 @@ recode_perror (_GL_UNUSED RECODE_OUTER outer, const char *format, ...)
   fflush (stderr);
 }
 
+/* Memory allocation.  */
+
+/*----------------------------------------------------------------------.
+| Allocate SIZE bytes through the allocator of OUTER, all set to zero.  |
+`----------------------------------------------------------------------*/
+
 _GL_ATTRIBUTE_MALLOC void *
 recode_malloc (RECODE_OUTER outer, size_t size)
 {
   void *result;
 
-  result = calloc (1, size);
-  if (!result)
+  result = (*outer->allocator.allocate) (outer->allocator.closure, size);
+  if (result)
+    memset (result, 0, size);
+  else
     recode_error (outer, _("Virtual memory exhausted"));
 
   return result;
@@ -76,12 +84,141 @@ recode_realloc (RECODE_OUTER outer, void *pointer, size_t size)
 {
   void *result;
 
-  result = realloc (pointer, size);
+  result = (*outer->allocator.reallocate) (outer->allocator.closure,
+					   pointer, size);
   if (!result)
     recode_error (outer, _("Virtual memory exhausted"));
 
   return result;
 }
+
+/*-------------------------------------------------------------------.
+| Free POINTER, which was allocated through the allocator of OUTER.  |
+`-------------------------------------------------------------------*/
+
+void
+recode_free (RECODE_OUTER outer, void *pointer)
+{
+  if (pointer)
+    (*outer->allocator.release) (outer->allocator.closure, pointer);
+}
+
+/* Arena allocation.  */
+
+/* Arena chunks are never smaller than this, and each is at least twice as
+   big as the one before.  */
+#define ARENA_CHUNK_SIZE 4096
+
+/* All blocks get aligned as strictly as any of these types.  */
+
+union arena_alignment
+  {
+    long double long_double_value;
+    long long long_long_value;
+    void *pointer_value;
+    void (*function_value) (void);
+  };
+
+#define ARENA_ALIGN(Size) \
+  (((Size) + sizeof (union arena_alignment) - 1)			\
+   / sizeof (union arena_alignment) * sizeof (union arena_alignment))
+
+struct recode_arena_chunk
+  {
+    struct recode_arena_chunk *previous; /* chunk allocated before this one */
+    size_t size;		/* usable size after the chunk header */
+  };
+
+#define CHUNK_HEADER_SIZE ARENA_ALIGN (sizeof (struct recode_arena_chunk))
+
+/*------------------------------------------------------------------------.
+| Create an arena having room for SIZE bytes to start with.  The arena    |
+| descriptor itself lives within its first chunk, so it costs only one    |
+| allocation.  Return NULL if memory is exhausted.                        |
+`------------------------------------------------------------------------*/
+
+struct recode_arena *
+recode_new_arena (RECODE_OUTER outer, size_t size)
+{
+  size_t header_size
+    = CHUNK_HEADER_SIZE + ARENA_ALIGN (sizeof (struct recode_arena));
+  struct recode_arena_chunk *chunk;
+  struct recode_arena *arena;
+
+  size = ARENA_ALIGN (size);
+  if (!ALLOC_SIZE (chunk, header_size + size, struct recode_arena_chunk))
+    return NULL;
+  chunk->previous = NULL;
+  chunk->size = header_size - CHUNK_HEADER_SIZE + size;
+
+  arena = (struct recode_arena *) ((char *) chunk + CHUNK_HEADER_SIZE);
+  arena->outer = outer;
+  arena->chunk = chunk;
+  arena->cursor = (char *) chunk + header_size;
+  arena->limit = arena->cursor + size;
+  return arena;
+}
+
+/*---------------------------------------------------------------.
+| Free ARENA at once, with all blocks ever allocated out of it.  |
+`---------------------------------------------------------------*/
+
+void
+recode_delete_arena (struct recode_arena *arena)
+{
+  RECODE_OUTER outer = arena->outer;
+  struct recode_arena_chunk *chunk = arena->chunk;
+
+  /* The first chunk, holding the arena descriptor, is freed last.  */
+
+  while (chunk)
+    {
+      struct recode_arena_chunk *previous = chunk->previous;
+
+      recode_free (outer, chunk);
+      chunk = previous;
+    }
+}
+
+/*-----------------------------------------------------------------------.
+| Allocate SIZE bytes out of ARENA, all set to zero.  Return NULL if     |
+| memory is exhausted.                                                   |
+`-----------------------------------------------------------------------*/
+
+void *
+recode_arena_alloc (struct recode_arena *arena, size_t size)
+{
+  char *result;
+
+  size = ARENA_ALIGN (size);
+  if ((size_t) (arena->limit - arena->cursor) < size)
+    {
+      RECODE_OUTER outer = arena->outer;
+      size_t chunk_size = 2 * arena->chunk->size;
+      struct recode_arena_chunk *chunk;
+
+      if (chunk_size < ARENA_CHUNK_SIZE)
+	chunk_size = ARENA_CHUNK_SIZE;
+      if (chunk_size < size)
+	chunk_size = size;
+      if (!ALLOC_SIZE (chunk, CHUNK_HEADER_SIZE + chunk_size,
+		       struct recode_arena_chunk))
+	return NULL;
+      chunk->previous = arena->chunk;
+      chunk->size = chunk_size;
+
+      arena->chunk = chunk;
+      arena->cursor = (char *) chunk + CHUNK_HEADER_SIZE;
+      arena->limit = arena->cursor + chunk_size;
+    }
+
+  /* Chunks come cleared from recode_malloc, and blocks are never reused,
+     so there is no need to clear them here.  */
+
+  result = arena->cursor;
+  arena->cursor += size;
+  return result;
+}
 
 /* Single step handling.  */
 
@@ -90,14 +227,15 @@ recode_realloc (RECODE_OUTER outer, void *pointer, size_t size)
 `------------------------------------------------------------------*/
 
 unsigned char *
-recode_invert_table (RECODE_OUTER outer, const unsigned char *table)
+recode_invert_table (RECODE_CONST_REQUEST request, const unsigned char *table)
 {
+  RECODE_OUTER outer = request->outer;
   unsigned char flag[256];
   unsigned char *result;
   bool table_error;
   unsigned counter;
 
-  if (!ALLOC (result, 256, unsigned char))
+  if (!ARENA_ALLOC (result, request->arena, 256, unsigned char))
     return NULL;
   memset (flag, 0, 256);
   table_error = false;
@@ -136,10 +274,11 @@ recode_invert_table (RECODE_OUTER outer, const unsigned char *table)
 `---------------------------------------------------------------------------*/
 
 bool
-recode_complete_pairs (RECODE_OUTER outer, RECODE_STEP step,
+recode_complete_pairs (RECODE_CONST_REQUEST request, RECODE_STEP step,
 		const struct recode_known_pair *known_pairs,
 		unsigned number_of_pairs, bool first_half_implied, bool reverse)
 {
+  RECODE_OUTER outer = request->outer;
   unsigned char left_flag[256];
   unsigned char right_flag[256];
   unsigned char left_table[256];
@@ -244,12 +383,11 @@ recode_complete_pairs (RECODE_OUTER outer, RECODE_STEP step,
       /* Save a copy of the proper table.  */
 
       step->transform_routine = recode_transform_byte_to_byte;
-      if (!ALLOC (table, 256, unsigned char))
+      if (!ARENA_ALLOC (table, request->arena, 256, unsigned char))
 	return false;
       memcpy (table, reverse ? right_table : left_table, 256);
       step->step_type = RECODE_BYTE_TO_BYTE;
       step->step_table = table;
-      step->step_table_term_routine = free;
 
       /* Upgrade step quality to reversible.  */
 
@@ -273,14 +411,15 @@ recode_complete_pairs (RECODE_OUTER outer, RECODE_STEP step,
 	  table = left_table;
 	}
 
-      /* Allocate everything in one blow, so it will be freed likewise.  */
+      /* Allocate everything in one blow.  */
 
       used = 0;
       for (counter = 0; counter < 256; counter++)
 	if (flag[counter])
 	  used++;
 
-      if (!ALLOC_SIZE (table2, 256 * sizeof (char *) + 2 * used, const char *))
+      if (!ARENA_ALLOC_SIZE (table2, request->arena,
+			     256 * sizeof (char *) + 2 * used, const char *))
 	return false;
       cursor = (char *) (table2 + 256);
 
@@ -301,7 +440,6 @@ recode_complete_pairs (RECODE_OUTER outer, RECODE_STEP step,
       step->transform_routine = recode_transform_byte_to_variable;
       step->step_type = RECODE_BYTE_TO_STRING;
       step->step_table = table2;
-      step->step_table_term_routine = free;
     }
 
   return true;
@@ -379,8 +517,6 @@ static bool
 term_ucs2_to_byte (RECODE_STEP step)
 {
   hash_free (((struct ucs2_to_byte_local *) step->local)->table);
-  free (((struct ucs2_to_byte_local *) step->local)->data);
-  free (step->local);
   return true;
 }
 
@@ -390,7 +526,6 @@ recode_init_ucs2_to_byte (RECODE_STEP step,
 		   RECODE_CONST_OPTION_LIST before_options,
 		   RECODE_CONST_OPTION_LIST after_options)
 {
-  RECODE_OUTER outer = request->outer;
   Hash_table *table;
   struct ucs2_to_byte *data;
   unsigned counter;
@@ -403,7 +538,7 @@ recode_init_ucs2_to_byte (RECODE_STEP step,
   if (!table)
     return false;
 
-  if (!ALLOC (data, 256, struct ucs2_to_byte))
+  if (!ARENA_ALLOC (data, request->arena, 256, struct ucs2_to_byte))
     {
       hash_free (table);
       return false;
@@ -416,15 +551,14 @@ recode_init_ucs2_to_byte (RECODE_STEP step,
       if (!hash_insert (table, data + counter))
 	{
 	  hash_free (table);
-	  free (data);
 	  return false;
 	}
     }
 
-  if (!ALLOC (step->local, 1, struct ucs2_to_byte_local))
+  if (!ARENA_ALLOC (step->local, request->arena, 1,
+		    struct ucs2_to_byte_local))
     {
       hash_free (table);
-      free (data);
       return false;
     }
   ((struct ucs2_to_byte_local *) step->local)->table = table;
@@ -746,10 +880,14 @@ recode_format_table (RECODE_REQUEST request,
   else
     {
       recode_error (outer, _("No table to print"));
-      free (name);
+      if (header_name)
+	recode_free (outer, name);
       return false;
     }
 
-  free (name);
+  /* Without HEADER_NAME, NAME is the request work string, kept for later.  */
+
+  if (header_name)
+    recode_free (outer, name);
   return true;
 }
@@ -43,6 +43,18 @@ enum recode_programming_language
   RECODE_LANGUAGE_C,		/* C (or C++) */
   RECODE_LANGUAGE_PERL		/* Perl */
 };
+
+/* Memory allocation hooks.  Each routine receives CLOSURE as its first
+   argument.  All three routines have to be given, and they should be
+   safe to call from any thread that uses the library concurrently.  */
+
+struct recode_allocator
+{
+  void *(*allocate) (void *closure, size_t size);
+  void *(*reallocate) (void *closure, void *pointer, size_t size);
+  void (*release) (void *closure, void *pointer);
+  void *closure;
+};
 
 /* Function prototypes.  */
 
@@ -60,7 +72,10 @@ extern "C" {
 #define RECODE_FORCE_FLAG 8
 
 RECODE_OUTER recode_new_outer (unsigned);
+RECODE_OUTER recode_new_outer_with_allocator (unsigned,
+                                              const struct recode_allocator *);
 bool recode_delete_outer (RECODE_OUTER);
+void recode_free (RECODE_OUTER, void *);
 
 bool recode_list_all_symbols (RECODE_OUTER, RECODE_CONST_SYMBOL);
 bool recode_list_concise_charset (RECODE_OUTER, RECODE_CONST_SYMBOL,
@@ -90,6 +105,9 @@ bool recode_string_to_file (RECODE_CONST_REQUEST,
 bool recode_buffer_to_buffer (RECODE_CONST_REQUEST,
                               const char *, size_t,
                               char **, size_t *, size_t *);
+bool recode_buffer_preflight (RECODE_CONST_REQUEST,
+                              const char *, size_t,
+                              size_t *);
 bool recode_buffer_to_file (RECODE_CONST_REQUEST,
                             const char *, size_t,
                             FILE *);
@@ -106,6 +124,7 @@ bool recode_file_to_file (RECODE_CONST_REQUEST,
 
 RECODE_TASK recode_new_task (RECODE_CONST_REQUEST);
 bool recode_delete_task (RECODE_TASK);
+bool recode_task_reset (RECODE_TASK);
 bool recode_perform_task (RECODE_TASK);
 /* FILE *recode_filter_open (RECODE_TASK, FILE *); */
 /* bool recode_filter_close (RECODE_TASK); */
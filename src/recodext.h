@@ -121,6 +121,9 @@ struct recode_outer
     /* If we should ignore untranslatable input altogether.  */
     bool force;
 
+    /* Routines through which all library memory gets allocated.  */
+    struct recode_allocator allocator;
+
     /* charset.c */
     /* --------- */
 
@@ -136,11 +139,14 @@ struct recode_outer
     RECODE_SYMBOL symbol_list;
     unsigned number_of_symbols;
 
-    /* Arrays of strings ready for argmatch.  */
+    /* Names of charsets and of surfaces, normalized as for argmatch and
+       sorted, each array with a NULL sentinel, and the alias for each.  */
     char const **argmatch_charset_array;
     char const **argmatch_surface_array;
-    const char **realname_charset_array;
-    const char **realname_surface_array;
+    RECODE_ALIAS *charset_alias_array;
+    RECODE_ALIAS *surface_alias_array;
+    unsigned argmatch_charset_count;
+    unsigned argmatch_surface_count;
 
     /* recode.c */
     /* -------- */
@@ -284,7 +290,7 @@ enum recode_step_type
     RECODE_UCS2_TO_STRING,	/* hash from ucs2 to string */
     RECODE_STRING_TO_UCS2,	/* hash from ucs2 to string, reversed */
     RECODE_COMBINE_EXPLODE,	/* raw data for combining or exploding */
-    RECODE_COMBINE_STEP,	/* special hash for combining */
+    RECODE_COMBINE_STEP,	/* compiled states for combining */
     RECODE_EXPLODE_STEP		/* special hash for exploding */
   };
 
@@ -325,6 +331,23 @@ struct recode_option_list
     RECODE_OPTION_LIST next;
   };
 
+/*-------------------------------------------------------------------------.
+| An arena quickly hands out many small blocks of memory, none of which    |
+| may be freed individually.  They all go away at once when the arena is   |
+| deleted.  Requests and tasks each own an arena, for the objects living   |
+| exactly as long as they do.                                              |
+`-------------------------------------------------------------------------*/
+
+struct recode_arena_chunk;
+
+struct recode_arena
+  {
+    RECODE_OUTER outer;		/* for reaching the allocator */
+    struct recode_arena_chunk *chunk; /* current chunk, chained backwards */
+    char *cursor;		/* next free byte in current chunk */
+    char *limit;		/* end of current chunk */
+  };
+
 /*------------------------------------------------------------------------.
 | A recoding request holds, among other things, a selected path among the |
 | available recoding steps, it so represents a kind of recoding plan.     |
@@ -335,6 +358,10 @@ struct recode_request
     /* A request is always associated with a recoding system.  */
     RECODE_OUTER outer;
 
+    /* Arena holding the request itself, and the step tables, step local
+       data and option lists it needs.  */
+    struct recode_arena *arena;
+
     /* By setting the following flag, the program will echo to stderr the
        sequence of elementary recoding steps needed to achieve the requested
        recoding.  */
@@ -440,6 +467,20 @@ struct recode_subtask
     /* Line count and character count in last line, both zero-based.  */
     unsigned newline_count;
     unsigned character_count;
+
+    /* If the output is only being measured, it gets emptied rather than
+       grown when full, and the bytes so dropped are counted here.  */
+    bool discard_output;
+    size_t discarded_bytes;
+
+    /* Byte-swapped UCS-2 input gets normalized in bulk into SWAPPED, up
+       to the next byte order mark.  SWAPPED_CURSOR tells where the input
+       cursor should be for SWAPPED to be used from SWAPPED_INDEX on, until
+       SWAPPED_LENGTH.  */
+    const char *swapped_cursor;
+    unsigned swapped_index;
+    unsigned swapped_length;
+    char swapped[256];
   };
 
 #define GOT_CHARACTER(Subtask) \
@@ -448,6 +489,16 @@ struct recode_subtask
 #define GOT_NEWLINE(Subtask) \
   ((Subtask)->newline_count++, (Subtask)->character_count = 0)
 
+/*-------------------------------------------------------------------------.
+| Tell if the input text of SUBTASK lies wholly in memory, from its cursor |
+| to its limit, so a block kernel may process it in large chunks instead   |
+| of calling recode_get_byte for each byte.  A task may insist on the      |
+| reference byte path, for checking that both paths agree.                 |
+`-------------------------------------------------------------------------*/
+
+#define BLOCK_INPUT(Subtask) \
+  (!(Subtask)->input.file && !(Subtask)->task->reference_path)
+
 /*--------------------------------------------------------------------------.
 | A recoding task associates a sequence of steps to a given input text, for |
 | producing a corresponding output text.  It holds an array of subtasks.    |
@@ -458,6 +509,13 @@ struct recode_task
     /* Associated request.  */
     RECODE_CONST_REQUEST request;
 
+    /* Arena holding the task itself, and anything living as long.  */
+    struct recode_arena *arena;
+
+    /* Buffers for intermediate texts between steps, kept from one
+       recoding to the next, until the task gets deleted.  */
+    struct recode_read_write_text scratch[2];
+
     /* Initial input and final output.  */
     struct recode_read_only_text input;
     struct recode_read_write_text output;
@@ -468,6 +526,14 @@ struct recode_task
     /* The input UCS-2 stream might have bytes swapped (status variable).  */
     enum recode_swap_input swap_input : 3;
 
+    /* Never use block kernels, read the input one byte at a time instead.
+       This reference path is meant for validating these kernels.  */
+    bool reference_path : 1;
+
+    /* Only count the bytes of a memory output into measured_size, rather
+       than keeping them.  This is meant for exactly sizing buffers.  */
+    bool measure_output : 1;
+
     /* Error processing.  */
     /* -----------------  */
 
@@ -482,6 +548,24 @@ struct recode_task
 
     /* Step being executed when error_so_far was last set.  */
     RECODE_CONST_STEP error_at_step;
+
+    /* Offset into the step input when error_so_far was last set, or zero
+       if that input was a file.  */
+    size_t error_at_offset;
+
+    /* Final output size, when measure_output is set.  */
+    size_t measured_size;
+  };
+
+/*------------------------------------------------------------------------.
+| A span designates one among many small memory texts, to be recoded all  |
+| at once by recode_buffers_batch.                                        |
+`------------------------------------------------------------------------*/
+
+struct recode_span
+  {
+    const char *buffer;		/* start of text */
+    size_t size;		/* number of bytes in text */
   };
 
 /* Specialities for some function arguments.  */
@@ -554,8 +638,19 @@ void recode_perror (RECODE_OUTER, const char *, ...);
 void *recode_malloc (RECODE_OUTER, size_t);
 void *recode_realloc (RECODE_OUTER, void *, size_t);
 
-unsigned char *recode_invert_table (RECODE_OUTER, const unsigned char *);
-bool recode_complete_pairs (RECODE_OUTER, RECODE_STEP,
+#define ARENA_ALLOC_SIZE(Variable, Arena, Size, Type) \
+  (Variable = (Type *) recode_arena_alloc ((Arena), (Size)))
+
+#define ARENA_ALLOC(Variable, Arena, Count, Type) \
+  ARENA_ALLOC_SIZE (Variable, Arena, (Count) * sizeof (Type), Type)
+
+struct recode_arena *recode_new_arena (RECODE_OUTER, size_t);
+void recode_delete_arena (struct recode_arena *);
+void *recode_arena_alloc (struct recode_arena *, size_t);
+
+unsigned char *recode_invert_table (RECODE_CONST_REQUEST,
+                                    const unsigned char *);
+bool recode_complete_pairs (RECODE_CONST_REQUEST, RECODE_STEP,
                      const struct recode_known_pair *, unsigned,
                      bool, bool);
 bool recode_transform_byte_to_ucs2 (RECODE_SUBTASK);
@@ -566,8 +661,13 @@ bool recode_transform_ucs2_to_byte (RECODE_SUBTASK);
 
 /* charname.c and fr-charname.c.  */
 
+/* Room needed for any charname, including its final NUL.  */
+#define RECODE_CHARNAME_SIZE 128
+
 const char *recode_ucs2_to_charname (int);
+const char *recode_ucs2_to_charname_r (int, char *);
 const char *recode_ucs2_to_french_charname (int);
+const char *recode_ucs2_to_french_charname_r (int, char *);
 
 /* charset.c.  */
 
@@ -582,12 +682,13 @@ enum alias_find_type
 
 int recode_code_to_ucs2 (RECODE_CONST_SYMBOL, unsigned);
 bool recode_prepare_for_aliases (RECODE_OUTER);
+void recode_delete_aliases (RECODE_OUTER);
 RECODE_ALIAS recode_declare_alias (RECODE_OUTER,
                                    const char *, const char *);
 bool recode_declare_implied_surface (RECODE_OUTER, RECODE_ALIAS,
                                      RECODE_CONST_SYMBOL);
 bool recode_make_argmatch_arrays (RECODE_OUTER);
-void recode_delete_alias (RECODE_ALIAS alias);
+void recode_delete_alias (RECODE_OUTER, RECODE_ALIAS);
 RECODE_ALIAS recode_find_alias (RECODE_OUTER, const char *,
                                 enum alias_find_type);
 bool recode_find_and_report_subsets (RECODE_OUTER);
@@ -622,6 +723,7 @@ void recode_freeze_tables (RECODE_OUTER);
 
 bool module_iconv (struct recode_outer *);
 void delmodule_iconv (struct recode_outer *);
+bool recode_init_iconv (RECODE_STEP, RECODE_CONST_REQUEST);
 bool recode_transform_with_iconv (RECODE_SUBTASK);
 
 /* names.c.  */
@@ -648,6 +750,10 @@ bool recode_declare_explode_data (RECODE_OUTER, const unsigned short *,
 bool recode_declare_strip_data (RECODE_OUTER, struct strip_data *,
                                 const char *);
 
+/* permut.c.  */
+
+void recode_swap_pairs (char *, const char *, size_t);
+
 /* pool.c.  */
 
 extern const recode_ucs2 ucs2_data_pool[];
@@ -655,6 +761,10 @@ extern const recode_ucs2 ucs2_data_pool[];
 /* request.c.  */
 
 char *recode_edit_sequence (RECODE_REQUEST, bool);
+char *recode_buffers_batch (RECODE_CONST_REQUEST,
+                            const struct recode_span *, size_t,
+                            struct recode_arena *,
+                            size_t *, enum recode_error *);
 
 /* rfc1345.c.  */
 
@@ -669,6 +779,8 @@ void recode_put_bytes (const char *, size_t, RECODE_SUBTASK);
 bool recode_if_nogo (enum recode_error, RECODE_SUBTASK);
 bool recode_transform_byte_to_byte (RECODE_SUBTASK);
 bool recode_transform_byte_to_variable (RECODE_SUBTASK);
+bool recode_perform_batch (RECODE_TASK, const struct recode_span *, size_t,
+                           size_t *, enum recode_error *);
 
 /* ucs.c.  */
 
@@ -712,8 +824,8 @@ bool recode_put_ucs4 (unsigned, RECODE_SUBTASK);
    `subtask' quite systematically, so it may be used as a constant, here.  */
 # define ECHO \
     do {							\
-      const char *cursor = librecode_yytext;			\
-      int counter = librecode_yyleng;				\
+      const char *cursor = yytext;				\
+      int counter = yyleng;					\
       for (; counter > 0; cursor++, counter--)			\
 	recode_put_byte (*cursor, subtask);				\
     } while (false)
@@ -22,23 +22,25 @@
 
 /* Quality handling.  */
 
-/*---------------------------------------.
-| Return a string describing a quality.	 |
-`---------------------------------------*/
+/* Room for any string describing a quality.  */
+#define QUALITY_STRING_SIZE 100
+
+/*-----------------------------------------------------------------.
+| Return a string describing a quality, which might be written in  |
+| BUFFER, having QUALITY_STRING_SIZE bytes.                        |
+`-----------------------------------------------------------------*/
 
 static const char *
-quality_to_string (struct recode_quality quality)
+quality_to_string (struct recode_quality quality, char *buffer)
 {
-  static char buffer[100];
-
   if (quality.reversible)
     return _("reversible");
 
-  sprintf (buffer, _("%s to %s"),
-	   (quality.in_size == RECODE_1 ? _("byte")
-	    : quality.in_size == RECODE_2 ? _("ucs2") : _("variable")),
-	   (quality.out_size == RECODE_1 ? _("byte")
-	    : quality.out_size == RECODE_2 ? _("ucs2") : _("variable")));
+  snprintf (buffer, QUALITY_STRING_SIZE, _("%s to %s"),
+	    (quality.in_size == RECODE_1 ? _("byte")
+	     : quality.in_size == RECODE_2 ? _("ucs2") : _("variable")),
+	    (quality.out_size == RECODE_1 ? _("byte")
+	     : quality.out_size == RECODE_2 ? _("ucs2") : _("variable")));
   return buffer;
 }
 
@@ -68,12 +70,11 @@ add_work_character (RECODE_REQUEST request, int character)
 {
   if (request->work_string_length + 1 >= request->work_string_allocated)
     {
-      char *new_work_string;
+      RECODE_OUTER outer = request->outer;
+      char *new_work_string = request->work_string;
 
       request->work_string_allocated += 100;
-      new_work_string = (char *)
-	realloc (request->work_string, request->work_string_allocated);
-      if (new_work_string)
+      if (REALLOC (new_work_string, request->work_string_allocated, char))
         request->work_string = new_work_string;
       else
         return; /* the diagnostic gets truncated, no need to fuss about it.  */
@@ -181,6 +182,7 @@ recode_edit_sequence (RECODE_REQUEST request, bool edit_quality)
       if (edit_quality)
 	{
 	  struct recode_quality quality = outer->quality_byte_reversible;
+	  char buffer[QUALITY_STRING_SIZE];
 	  RECODE_CONST_STEP step2;
 
 	  for (step2 = request->sequence_array;
@@ -189,7 +191,7 @@ recode_edit_sequence (RECODE_REQUEST request, bool edit_quality)
 	    merge_qualities (&quality, step2->quality);
 	  add_work_character (request, ' ');
 	  add_work_character (request, '(');
-	  add_work_string (request, quality_to_string (quality));
+	  add_work_string (request, quality_to_string (quality, buffer));
 	  add_work_character (request, ')');
 	}
     }
@@ -333,7 +335,7 @@ find_sequence (RECODE_REQUEST request,
     {
       /* No path has been found.  */
 
-      free (search_array);
+      recode_free (outer, search_array);
       return false;
     }
 
@@ -348,7 +350,7 @@ find_sequence (RECODE_REQUEST request,
 	break;
     }
 
-  free (search_array);
+  recode_free (outer, search_array);
   return charset == after;
 }
 
@@ -410,7 +412,7 @@ compare_struct_item (const void *void_first, const void *void_second)
 `------------------------------------------------------------------------*/
 
 static bool
-complete_double_ucs2_step (RECODE_OUTER outer, RECODE_STEP step)
+complete_double_ucs2_step (RECODE_CONST_REQUEST request, RECODE_STEP step)
 {
   struct side
     {
@@ -526,17 +528,10 @@ complete_double_ucs2_step (RECODE_OUTER outer, RECODE_STEP step)
   /* Complete the recoding table out of this.  */
 
   return
-    recode_complete_pairs (outer, step,
+    recode_complete_pairs (request, step,
 		    pair_array, pair_cursor - pair_array, false, reversed);
 }
 
-static bool
-delete_compressed_one_to_many (RECODE_STEP step)
-{
-  free (step->local);
-  return true;
-}
-
 static void
 delete_step (RECODE_STEP step)
 {
@@ -597,10 +592,12 @@ simplify_sequence (RECODE_REQUEST request)
 	out->quality = in[0].quality;
 	merge_qualities (&out->quality, in[1].quality);
 	out->transform_routine = recode_transform_byte_to_byte;
+	out->term_routine = NULL;
+	out->step_table_term_routine = NULL;
 
 	/* Initialize the new single step, so it can be later merged with
 	   others.  */
-	if (!complete_double_ucs2_step (outer, out))
+	if (!complete_double_ucs2_step (request, out))
 	  return false;
 
 	in += 2;
@@ -621,6 +618,8 @@ simplify_sequence (RECODE_REQUEST request)
 	out->quality = in[0].quality;
 	merge_qualities (&out->quality, in[1].quality);
 	out->transform_routine = recode_transform_with_iconv;
+	if (!recode_init_iconv (out, request))
+	  return false;
 
 	in += 2;
 	saved_steps++;
@@ -649,7 +648,7 @@ simplify_sequence (RECODE_REQUEST request)
 	/* Initialise a cumulative one-to-one recoding with the identity
 	   permutation.  Just avoid doing it if not enough memory.  */
 
-	&& ALLOC (accum, 256, unsigned char))
+	&& ARENA_ALLOC (accum, request->arena, 256, unsigned char))
       {
 	memcpy (accum, in->step_table, 256);
 	out->before = in->before;
@@ -657,6 +656,13 @@ simplify_sequence (RECODE_REQUEST request)
 	out->quality = in->quality;
 	delete_step (in++);
 
+	/* The merged tables live in the request arena, and the strings of
+	   a merged one-to-many table stay within the arena as well, so the
+	   new step has nothing to clean up.  */
+
+	out->term_routine = NULL;
+	out->step_table_term_routine = NULL;
+
 	/* Merge in all consecutive one-to-one recodings.  */
 
 	while (in < limit
@@ -681,21 +687,14 @@ simplify_sequence (RECODE_REQUEST request)
 	    /* Merge in the one-to-many recoding.  Just avoid doing it if not
 	       enough memory.  */
 
-	    && (ALLOC (string, 256, const char *)))
+	    && (ARENA_ALLOC (string, request->arena, 256, const char *)))
 	  {
 	    const char *const *table = (const char *const *) in->step_table;
 
 	    for (counter = 0; counter < 256; counter++)
 	      string[counter] = table[accum[counter]];
-	    free (accum);
 	    out->step_type = RECODE_BYTE_TO_STRING;
 	    out->step_table = string;
-            if (in->step_table_term_routine)
-              {
-                out->local = (void *) table;   /* Save reference to old table for destructor.  */
-                out->term_routine = delete_compressed_one_to_many;
-              }
-            out->step_table_term_routine = free;
 	    out->transform_routine = recode_transform_byte_to_variable;
 	    out->after = in->after;
 	    merge_qualities (&out->quality, in->quality);
@@ -769,14 +768,13 @@ scan_identifier (RECODE_REQUEST request)
 static RECODE_OPTION_LIST
 scan_options (RECODE_REQUEST request)
 {
-  RECODE_OUTER outer = request->outer;
   RECODE_OPTION_LIST list = NULL;
   RECODE_OPTION_LIST last = NULL;
 
   while (*request->scan_cursor == '+')
     {
       RECODE_OPTION_LIST new_
-	= ALLOC (new_, 1, struct recode_option_list);
+	= ARENA_ALLOC (new_, request->arena, 1, struct recode_option_list);
       char *copy;
 
       if (!new_)
@@ -784,12 +782,10 @@ scan_options (RECODE_REQUEST request)
 
       request->scan_cursor++;
       scan_identifier (request);
-      ALLOC (copy, strlen (request->scanned_string) + 1, char);
+      ARENA_ALLOC (copy, request->arena,
+		   strlen (request->scanned_string) + 1, char);
       if (!copy)
-	{
-	  free (new_);
-	  break;		/* FIXME: should interrupt decoding */
-	}
+	break;			/* FIXME: should interrupt decoding */
       strcpy (copy, request->scanned_string);
 
       new_->option = copy;
@@ -1069,7 +1065,7 @@ decode_request (RECODE_REQUEST request, const char *string)
     {
       if (!scan_request (request))
 	{
-	  free (request->scanned_string);
+	  recode_free (outer, request->scanned_string);
 	  return false;
 	}
       while (*request->scan_cursor == ',')
@@ -1077,13 +1073,13 @@ decode_request (RECODE_REQUEST request, const char *string)
 	  request->scan_cursor++;
 	  if (!scan_request (request))
 	    {
-	      free (request->scanned_string);
+	      recode_free (outer, request->scanned_string);
 	      return false;
 	    }
 	}
     }
 
-  free (request->scanned_string);
+  recode_free (outer, request->scanned_string);
   return true;
 }
 
@@ -1102,7 +1098,7 @@ decode_request (RECODE_REQUEST request, const char *string)
 static bool
 guarantee_nul_terminator (RECODE_TASK task)
 {
-  if (task->output.cursor + 4 >= task->output.limit)
+  if (task->output.cursor + 4 > task->output.limit)
     {
       RECODE_OUTER outer = task->request->outer;
       size_t size = task->output.cursor - task->output.buffer;
@@ -1126,12 +1122,21 @@ guarantee_nul_terminator (RECODE_TASK task)
 RECODE_REQUEST
 recode_new_request (RECODE_OUTER outer)
 {
+  struct recode_arena *arena;
   RECODE_REQUEST request;
 
-  if (!ALLOC (request, 1, struct recode_request))
+  /* The request goes into its own arena, with some room for step tables.  */
+
+  if (arena = recode_new_arena (outer, 1024), !arena)
     return NULL;
+  if (!ARENA_ALLOC (request, arena, 1, struct recode_request))
+    {
+      recode_delete_arena (arena);
+      return NULL;
+    }
 
   request->outer = outer;
+  request->arena = arena;
   request->diaeresis_char = '"';
 
   request->work_string_allocated = 0;
@@ -1141,13 +1146,15 @@ recode_new_request (RECODE_OUTER outer)
 bool
 recode_delete_request (RECODE_REQUEST request)
 {
+  RECODE_OUTER outer = request->outer;
+
   for (RECODE_STEP step = request->sequence_array;
        step < request->sequence_array + request->sequence_length;
        step++)
     delete_step (step);
-  free (request->sequence_array);
-  free (request->work_string);
-  free (request);
+  recode_free (outer, request->sequence_array);
+  recode_free (outer, request->work_string);
+  recode_delete_arena (request->arena);
   return true;
 }
 
@@ -1224,6 +1231,37 @@ recode_buffer_to_buffer (RECODE_CONST_REQUEST request,
   return success;
 }
 
+/* Tell in *OUTPUT_LENGTH_POINTER the exact size recode_buffer_to_buffer
+   would produce out of INPUT_BUFFER, yet without keeping the output.  A
+   buffer allocated with four more bytes, for the NUL terminator, then
+   never needs to grow.  */
+
+bool
+recode_buffer_preflight (RECODE_CONST_REQUEST request,
+			 const char *input_buffer,
+			 size_t input_length,
+			 size_t *output_length_pointer)
+{
+  RECODE_OUTER outer = request->outer;
+  RECODE_TASK task = recode_new_task (request);
+  bool success;
+
+  if (!task)
+    return false;
+
+  task->input.buffer = input_buffer;
+  task->input.cursor = input_buffer;
+  task->input.limit = input_buffer + input_length;
+  task->measure_output = true;
+
+  success = recode_perform_task (task);
+  *output_length_pointer = task->measured_size;
+
+  recode_free (outer, task->output.buffer);
+  recode_delete_task (task);
+  return success;
+}
+
 bool
 recode_buffer_to_file (RECODE_CONST_REQUEST request,
 		       const char *input_buffer,
@@ -1293,3 +1331,38 @@ recode_file_to_file (RECODE_CONST_REQUEST request,
   recode_delete_task (task);
   return success;
 }
+
+/* Recode the N texts given by SPANS, and return their packed outputs into
+   a single block allocated from ARENA, with an extra NUL after them.  The
+   output for text COUNTER goes from OFFSETS[COUNTER] to OFFSETS[COUNTER + 1]
+   excluded, so OFFSETS needs room for N + 1 values.  If ERRORS is not NULL,
+   the maximum error met for each text is saved there.  Return NULL if out
+   of memory.  */
+
+char *
+recode_buffers_batch (RECODE_CONST_REQUEST request,
+		      const struct recode_span *spans, size_t n,
+		      struct recode_arena *arena,
+		      size_t *offsets, enum recode_error *errors)
+{
+  RECODE_OUTER outer = request->outer;
+  RECODE_TASK task = recode_new_task (request);
+  char *result;
+
+  if (!task)
+    return NULL;
+  if (!errors && !ARENA_ALLOC (errors, task->arena, n, enum recode_error))
+    {
+      recode_delete_task (task);
+      return NULL;
+    }
+
+  recode_perform_batch (task, spans, n, offsets, errors);
+  if (ARENA_ALLOC_SIZE (result, arena, offsets[n] + 1, char)
+      && offsets[n] > 0)
+    memcpy (result, task->output.buffer, offsets[n]);
+
+  recode_free (outer, task->output.buffer);
+  recode_delete_task (task);
+  return result;
+}
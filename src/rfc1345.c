@@ -27,57 +27,46 @@
 
 /*----------------------------------------------------------------------.
 | Return an RFC 1345 short form in a CHARSET for a given UCS2 value, or |
-| NULL if this value has no such known short form.		        |
+| NULL if this value has no such known short form.  The high byte of    |
+| the value selects a row of the index, the low byte a cell within it.  |
 `----------------------------------------------------------------------*/
 
 _GL_ATTRIBUTE_CONST const char *
 recode_ucs2_to_rfc1345 (recode_ucs2 code)
 {
-  int first = 0;
-  int last = TABLE_LENGTH;
-
-  while (first < last)
-    {
-      int middle = (first + last) / 2;
-      const struct entry *entry = &table[middle];
-
-      if (entry->code < code)
-	first = middle + 1;
-      else if (entry->code > code)
-	last = middle;
-      else
-	return entry->rfc1345;
-    }
+  int index = mnemonic_row[mnemonic_page[code >> 8]][code & 0xFF];
 
-  return NULL;
+  return index < 0 ? NULL : table[index].rfc1345;
 }
 
+/* Mix a mnemonic hash VALUE with SEED into a slot of `mnemonic_slot'.  */
+#define MNEMONIC_SLOT(Value, Seed) \
+  ((((Value) ^ (Seed)) * 2654435761u & 0xFFFFFFFFu) \
+   >> (32 - MNEMONIC_SLOT_BITS))
+
 /*---------------------------------------------------------------------.
 | Return an UCS-2 value, given an RFC 1345 short form in a CHARSET, or |
-| BIT_MASK (16) if the short form is unknown.                              |
+| NOT_A_CHARACTER if the short form is unknown.  The string is hashed  |
+| once, and the seeded slot holds the only candidate worth comparing.  |
 `---------------------------------------------------------------------*/
 
 static _GL_ATTRIBUTE_PURE recode_ucs2
 rfc1345_to_ucs2 (const char *string)
 {
-  int first = 0;
-  int last = TABLE_LENGTH;
-
-  while (first < last)
-    {
-      int middle = (first + last) / 2;
-      const struct entry *entry = &table[inverse[middle]];
-      int value = strcmp (entry->rfc1345, string);
-
-      if (value < 0)
-	first = middle + 1;
-      else if (value > 0)
-	last = middle;
-      else
-	return entry->code;
-    }
+  const unsigned char *cursor;
+  unsigned value = 2166136261u;
+  int index;
+
+  for (cursor = (const unsigned char *) string; *cursor; cursor++)
+    value = (value ^ *cursor) * 16777619u & 0xFFFFFFFFu;
+
+  index = mnemonic_slot[MNEMONIC_SLOT (value,
+				       mnemonic_seed[value
+						     % MNEMONIC_BUCKET_COUNT])];
+  if (index < 0 || strcmp (table[index].rfc1345, string) != 0)
+    return NOT_A_CHARACTER;
 
-  return NOT_A_CHARACTER;
+  return table[index].code;
 }
 
 /* Steps.  */
@@ -228,28 +217,19 @@ transform_rfc1345_ucs2 (RECODE_SUBTASK subtask)
 | Initialise the steps.  |
 `-----------------------*/
 
-static bool
-term_rfc1345 (RECODE_STEP step)
-{
-  free (step->local);
-  return true;
-}
-
 static bool
 init_rfc1345 (RECODE_CONST_REQUEST request,
 	      RECODE_STEP step,
 	      RECODE_CONST_OPTION_LIST options _GL_UNUSED)
 {
-  RECODE_OUTER outer = request->outer;
   struct local *local;
 
-  if (!ALLOC (local, 1, struct local))
+  if (!ARENA_ALLOC (local, request->arena, 1, struct local))
     return false;
 
   local->intro = '&';
 
   step->local = local;
-  step->term_routine = term_rfc1345;
   return true;
 }
 
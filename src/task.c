@@ -60,10 +60,10 @@ recode_get_bytes (RECODE_SUBTASK subtask, char *data, size_t n)
     return fread (data, 1, n, subtask->input.file);
   else
     {
-      size_t bytes_left = subtask->output.limit - subtask->output.cursor;
+      size_t bytes_left = subtask->input.limit - subtask->input.cursor;
       size_t bytes_to_copy = MIN (n, bytes_left);
-      memcpy (data, subtask->output.cursor, bytes_to_copy);
-      subtask->output.cursor += bytes_to_copy;
+      memcpy (data, subtask->input.cursor, bytes_to_copy);
+      subtask->input.cursor += bytes_to_copy;
       return bytes_to_copy;
     }
 }
@@ -95,22 +95,32 @@ recode_put_bytes (const char *data, size_t n, RECODE_SUBTASK subtask)
 {
   if (subtask->output.file)
     {
-      if (fwrite (data, n, 1, subtask->output.file) != 1)
+      if (n > 0 && fwrite (data, n, 1, subtask->output.file) != 1)
         {
           recode_perror (NULL, "fwrite ()");
           recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
         }
     }
   else {
+    if (subtask->output.cursor + n > subtask->output.limit
+	&& subtask->discard_output)
+      {
+	/* Only the size of this output matters, forget what it holds.  */
+
+	subtask->discarded_bytes
+	  += subtask->output.cursor - subtask->output.buffer;
+	subtask->output.cursor = subtask->output.buffer;
+      }
     if (subtask->output.cursor + n > subtask->output.limit)
       {
         RECODE_OUTER outer = subtask->task->request->outer;
         size_t old_size = subtask->output.limit - subtask->output.buffer;
         size_t new_size = old_size * 3 / 2 + 40 + n;
+        size_t used = subtask->output.cursor - subtask->output.buffer;
 
         if (REALLOC (subtask->output.buffer, new_size, char))
           {
-            subtask->output.cursor = subtask->output.buffer + old_size;
+            subtask->output.cursor = subtask->output.buffer + used;
             subtask->output.limit = subtask->output.buffer + new_size;
           }
         else
@@ -140,6 +150,8 @@ recode_if_nogo (enum recode_error new_error, RECODE_SUBTASK subtask)
     {
       task->error_so_far = new_error;
       task->error_at_step = subtask->step;
+      task->error_at_offset
+	= subtask->input.file ? 0 : subtask->input.cursor - subtask->input.buffer;
     }
   return task->error_so_far >= task->abort_level;
 }
@@ -186,6 +198,28 @@ recode_transform_byte_to_byte (RECODE_SUBTASK subtask)
     = (unsigned const char *) subtask->step->step_table;
   int input_char;
 
+  if (BLOCK_INPUT (subtask))
+    {
+      /* Translate the in-memory input a chunk at a time.  */
+
+      char buffer[BUFSIZ];
+
+      while (subtask->input.cursor < subtask->input.limit)
+	{
+	  const unsigned char *cursor
+	    = (const unsigned char *) subtask->input.cursor;
+	  size_t size = MIN ((size_t) (subtask->input.limit
+				       - subtask->input.cursor), BUFSIZ);
+	  size_t counter;
+
+	  for (counter = 0; counter < size; counter++)
+	    buffer[counter] = table[cursor[counter]];
+	  subtask->input.cursor += size;
+	  recode_put_bytes (buffer, size, subtask);
+	}
+      SUBTASK_RETURN (subtask);
+    }
+
   while (input_char = recode_get_byte (subtask), input_char != EOF)
     recode_put_byte (table[input_char], subtask);
 
@@ -218,6 +252,63 @@ recode_transform_byte_to_variable (RECODE_SUBTASK subtask)
   SUBTASK_RETURN (subtask);
 }
 
+/*-------------------------------------------------------------------------.
+| Estimate how many bytes the step of SUBTASK produces out of SIZE input   |
+| bytes, using the rough character sizes from its quality.  Characters of  |
+| variable size are taken as one byte on input and two bytes on output.    |
+| Without any step, the input is merely copied.  A buffer already given by |
+| the caller for the final output is trusted as it is, as it may have been |
+| sized through a preflight.                                               |
+`-------------------------------------------------------------------------*/
+
+static size_t
+estimate_output_size (RECODE_SUBTASK subtask, size_t size)
+{
+  static const unsigned char input_bytes[] = {1, 2, 4, 1};
+  static const unsigned char output_bytes[] = {1, 2, 4, 2};
+  RECODE_CONST_STEP step = subtask->step;
+
+  if (step)
+    size = (size / input_bytes[step->quality.in_size]
+	    * output_bytes[step->quality.out_size]);
+  size += 40;
+
+  if (subtask->output.buffer
+      && subtask->output.buffer == subtask->task->output.buffer)
+    size = MIN (size, (size_t) (subtask->output.limit
+				- subtask->output.cursor));
+  return size;
+}
+
+/*-------------------------------------------------------------------------.
+| Make room for SIZE more bytes in the memory output of SUBTASK, so this   |
+| output does not have to grow piecemeal while the step runs.  Return      |
+| false if memory is exhausted.                                            |
+`-------------------------------------------------------------------------*/
+
+static bool
+reserve_output (RECODE_SUBTASK subtask, size_t size)
+{
+  RECODE_OUTER outer = subtask->task->request->outer;
+  size_t used = subtask->output.cursor - subtask->output.buffer;
+  char *buffer;
+
+  if (subtask->output.file
+      || (size_t) (subtask->output.limit - subtask->output.cursor) >= size)
+    return true;
+
+  if (buffer = recode_realloc (outer, subtask->output.buffer, used + size),
+      !buffer)
+    {
+      recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
+      return false;
+    }
+  subtask->output.buffer = buffer;
+  subtask->output.cursor = buffer + used;
+  subtask->output.limit = buffer + used + size;
+  return true;
+}
+
 /*-------------------------------------------------------------------.
 | Close the subtask input file pointer if it is owned by librecode.  |
 `-------------------------------------------------------------------*/
@@ -256,11 +347,13 @@ recode_perform_task (RECODE_TASK task)
   RECODE_CONST_REQUEST request = task->request;
   struct recode_subtask subtask_block;
   RECODE_SUBTASK subtask = &subtask_block;
+  bool final_output = false;	/* if subtask->output is task->output */
+
+  /* Intermediate texts reuse the buffers left over by previous recodings
+     with this same task, if any.  */
 
-  struct recode_read_write_text input;
-  struct recode_read_write_text output;
-  memset (&input, 0, sizeof (struct recode_read_write_text));
-  memset (&output, 0, sizeof (struct recode_read_write_text));
+  struct recode_read_write_text input = task->scratch[0];
+  struct recode_read_write_text output = task->scratch[1];
 
   memset (subtask, 0, sizeof (struct recode_subtask));
   subtask->task = task;
@@ -324,6 +417,7 @@ recode_perform_task (RECODE_TASK task)
 	  /* Prepare the final output file.  */
 
 	  subtask->output = task->output;
+	  final_output = true;
 	  if (subtask->output.name)
 	    {
 	      if (!*subtask->output.name)
@@ -338,6 +432,25 @@ recode_perform_task (RECODE_TASK task)
 	    }
 	}
 
+      /* Size the output once for the whole step, when the input is in
+	 memory.  A final output being only measured rather needs little
+	 room, as it gets emptied whenever it fills.  */
+
+      subtask->step = (request->sequence_length > 0
+		       ? request->sequence_array + sequence_index : NULL);
+      subtask->discard_output = final_output && task->measure_output;
+      if (subtask->discard_output)
+	{
+	  if (!reserve_output (subtask, BUFSIZ))
+	    goto exit;
+	}
+      else if (!subtask->input.file
+	       && !reserve_output (subtask,
+				   estimate_output_size (subtask,
+							 subtask->input.limit
+							 - subtask->input.cursor)))
+	goto exit;
+
       /* Execute one recoding step.  */
 
       if (request->sequence_length == 0) {
@@ -347,9 +460,16 @@ recode_perform_task (RECODE_TASK task)
 
       if (child_process <= 0)
 	{
-	  subtask->step = request->sequence_array + sequence_index;
 	  (*subtask->step->transform_routine) (subtask);
 
+	  /* Keep hold of the intermediate output, which may have moved.  */
+
+	  if (sequence_index + 1 < (unsigned)request->sequence_length)
+	    {
+	      output = input;
+	      input = subtask->output;
+	    }
+
 	  /* Post-step clean up for memory sequence.  */
 
           if (!close_subtask_input (subtask))
@@ -358,12 +478,6 @@ recode_perform_task (RECODE_TASK task)
 	  /* Prepare for next step.  */
 
 	  task->swap_input = RECODE_SWAP_UNDECIDED;
-
-	  if (sequence_index + 1 < (unsigned)request->sequence_length)
-	    {
-	      output = input;
-	      input = subtask->output;
-	    }
 	}
 
       if (sequence_index + 1 == (unsigned)request->sequence_length)
@@ -385,13 +499,153 @@ recode_perform_task (RECODE_TASK task)
       recode_if_nogo (RECODE_SYSTEM_ERROR, subtask);
     }
 
-  free (input.buffer);
-  free (output.buffer);
+  /* Save intermediate buffers for the next recoding with this task.  */
+
+  task->scratch[0] = input;
+  task->scratch[1] = output;
 
-  task->output = subtask->output;
+  if (final_output)
+    {
+      task->output = subtask->output;
+      if (task->measure_output)
+	task->measured_size = (subtask->discarded_bytes
+			       + (subtask->output.cursor
+				  - subtask->output.buffer));
+    }
   SUBTASK_RETURN (subtask);
 }
 
+/*-------------------------------------------------------------------------.
+| Execute the conversion sequence for TASK over the N memory texts given   |
+| by SPANS, each step going over all texts before the next step starts.    |
+| Every text is recoded as if it was alone, and outputs are packed one     |
+| after another in the task output, text COUNTER being found between       |
+| OFFSETS[COUNTER] and OFFSETS[COUNTER + 1].  So, OFFSETS should have room |
+| for N + 1 values.  The maximum error met for each text is saved in       |
+| ERRORS; a text reaching the abort level gets an empty output.  Returns   |
+| false if any text has been found to be non-reversible.                   |
+`-------------------------------------------------------------------------*/
+
+bool
+recode_perform_batch (RECODE_TASK task,
+		      const struct recode_span *spans, size_t n,
+		      size_t *offsets, enum recode_error *errors)
+{
+  RECODE_CONST_REQUEST request = task->request;
+  struct recode_subtask subtask_block;
+  RECODE_SUBTASK subtask = &subtask_block;
+  enum recode_error worst_error = RECODE_NO_ERROR;
+  size_t total_size = 0;	/* size of all input texts */
+  size_t counter;
+
+  /* Intermediate texts reuse the buffers left over by previous recodings
+     with this same task, if any.  */
+
+  struct recode_read_write_text input = task->scratch[0];
+  struct recode_read_write_text output = task->scratch[1];
+
+  memset (subtask, 0, sizeof (struct recode_subtask));
+  subtask->task = task;
+  for (counter = 0; counter < n; counter++)
+    {
+      errors[counter] = RECODE_NO_ERROR;
+      total_size += spans[counter].size;
+    }
+  offsets[0] = 0;
+
+  /* Execute one pass for each step of the sequence, or a single copying
+     pass if there are no steps.  */
+
+  for (unsigned sequence_index = 0;
+       sequence_index == 0
+	 || sequence_index < (unsigned) request->sequence_length;
+       sequence_index++)
+    {
+      bool last_step
+	= sequence_index + 1 >= (unsigned) request->sequence_length;
+      size_t start = 0;		/* input offset of current text */
+
+      subtask->step = (request->sequence_length > 0
+		       ? request->sequence_array + sequence_index : NULL);
+      subtask->output = last_step ? task->output : output;
+      subtask->output.cursor = subtask->output.buffer;
+      if (!reserve_output (subtask,
+			   estimate_output_size (subtask,
+						 sequence_index == 0
+						 ? total_size : offsets[n])))
+	{
+	  /* Give up on all texts.  */
+
+	  for (counter = 0; counter < n; counter++)
+	    {
+	      errors[counter] = RECODE_SYSTEM_ERROR;
+	      offsets[counter + 1] = 0;
+	    }
+	  goto exit;
+	}
+
+      for (counter = 0; counter < n; counter++)
+	{
+	  /* Select the input text.  After the first step, OFFSETS still
+	     delimit the outputs of the previous step, and get overwritten
+	     as we go.  */
+
+	  if (sequence_index == 0)
+	    {
+	      subtask->input.buffer = spans[counter].buffer;
+	      subtask->input.limit = spans[counter].buffer + spans[counter].size;
+	    }
+	  else
+	    {
+	      subtask->input.buffer = input.buffer + start;
+	      subtask->input.limit = input.buffer + offsets[counter + 1];
+	      start = offsets[counter + 1];
+	    }
+	  subtask->input.cursor = subtask->input.buffer;
+
+	  /* Recode it, unless it was already given up.  */
+
+	  if (errors[counter] < task->abort_level)
+	    {
+	      task->error_so_far = errors[counter];
+	      task->swap_input = RECODE_SWAP_UNDECIDED;
+	      if (subtask->step)
+		(*subtask->step->transform_routine) (subtask);
+	      else
+		transform_mere_copy (subtask);
+	      errors[counter] = task->error_so_far;
+
+	      if (errors[counter] >= task->abort_level)
+		subtask->output.cursor = subtask->output.buffer + offsets[counter];
+	    }
+	  offsets[counter + 1] = subtask->output.cursor - subtask->output.buffer;
+	}
+
+      /* Keep hold of the output, which may have moved.  */
+
+      if (last_step)
+	task->output = subtask->output;
+      else
+	{
+	  output = input;
+	  input = subtask->output;
+	}
+    }
+
+ exit:
+  /* Save intermediate buffers for the next recoding with this task.  */
+
+  task->scratch[0] = input;
+  task->scratch[1] = output;
+
+  for (counter = 0; counter < n; counter++)
+    if (errors[counter] > worst_error)
+      worst_error = errors[counter];
+  task->error_so_far = worst_error;
+  task->swap_input = RECODE_SWAP_UNDECIDED;
+  SUBTASK_RETURN (subtask);
+}
+
 /* Library interface.  */
 
 /* See the recode manual for a more detailed description of the library
@@ -404,13 +658,18 @@ recode_perform_task (RECODE_TASK task)
 RECODE_TASK
 recode_new_task (RECODE_CONST_REQUEST request)
 {
-  RECODE_OUTER outer = request->outer;
+  struct recode_arena *arena;
   RECODE_TASK task;
 
-  if (!ALLOC (task, 1, struct recode_task))
+  /* The task goes into its own arena, which is freed along with it.  */
+
+  if (arena = recode_new_arena (request->outer, sizeof (struct recode_task)),
+      !arena)
     return NULL;
+  ARENA_ALLOC (task, arena, 1, struct recode_task);
 
   task->request = request;
+  task->arena = arena;
   task->fail_level = RECODE_NOT_CANONICAL;
   task->abort_level = RECODE_USER_ERROR;
   task->error_so_far = RECODE_NO_ERROR;
@@ -423,6 +682,29 @@ recode_new_task (RECODE_CONST_REQUEST request)
 bool
 recode_delete_task (RECODE_TASK task)
 {
-  free (task);
+  RECODE_OUTER outer = task->request->outer;
+
+  recode_free (outer, task->scratch[0].buffer);
+  recode_free (outer, task->scratch[1].buffer);
+  recode_delete_arena (task->arena);
+  return true;
+}
+
+/*-------------------------------------------------------------------------.
+| Prepare TASK for another recoding, as if it was new, yet keeping all its |
+| settings, output designation and buffers.  Memory output restarts at the |
+| beginning of the output buffer.  After the first few recodings, a reused |
+| task does not need to allocate memory anymore.                           |
+`-------------------------------------------------------------------------*/
+
+bool
+recode_task_reset (RECODE_TASK task)
+{
+  memset (&task->input, 0, sizeof (struct recode_read_only_text));
+  task->output.cursor = task->output.buffer;
+  task->swap_input = RECODE_SWAP_UNDECIDED;
+  task->error_so_far = RECODE_NO_ERROR;
+  task->error_at_step = NULL;
+  task->error_at_offset = 0;
   return true;
 }
@@ -20,7 +20,10 @@
 #include "config.h"
 #include "common.h"
 #include "decsteps.h"
-#include "hash.h"
+#include "minmax.h"
+#include "nproc.h"
+
+#include "glthread/thread.h"
 
 /*------------------------.
 | Produce test patterns.  |
@@ -114,40 +117,141 @@ test16_data (RECODE_SUBTASK subtask)
 | Produce frequency count for UCS-2 characters.  |
 `-----------------------------------------------*/
 
-struct ucs2_to_count
+/* Counts are kept in a flat array indexed by UCS-2 value.  */
+#define UCS2_COUNT (1 << 16)
+
+/* A text in memory is split between threads when each of them gets at
+   least COUNT_SLICE_SIZE bytes, and at most COUNT_THREAD_MAX threads.  */
+#define COUNT_SLICE_SIZE (1 << 20)
+#define COUNT_THREAD_MAX 16
+
+struct count_slice
   {
-    recode_ucs2 code;		/* UCS-2 value */
-    unsigned count;		/* corresponding count */
+    const unsigned char *cursor; /* first byte to count */
+    const unsigned char *limit;	/* one past the last byte to count */
+    bool swap;			/* if bytes come in little-endian order */
+    bool marked;		/* if a byte order mark was met */
+    unsigned long *counts;	/* histogram of this slice */
   };
 
-static size_t
-ucs2_to_count_hash (const void *void_data, size_t table_size)
+/*----------------------------------------------------------------------.
+| Count UCS-2 characters within a slice of memory, for one thread.  A   |
+| byte order mark stops the count, as it changes the meaning of what    |
+| follows and deserves a diagnostic; the caller then counts serially.   |
+`----------------------------------------------------------------------*/
+
+static void *
+count_slice (void *void_slice)
 {
-  const struct ucs2_to_count *data = (const struct ucs2_to_count *) void_data;
+  struct count_slice *slice = (struct count_slice *) void_slice;
+  unsigned long *counts = slice->counts;
+  const unsigned char *cursor;
+
+  for (cursor = slice->cursor; cursor < slice->limit; cursor += 2)
+    {
+      unsigned value = (slice->swap
+			? (unsigned) cursor[1] << 8 | cursor[0]
+			: (unsigned) cursor[0] << 8 | cursor[1]);
 
-  return data->code % table_size;
+      if (value == BYTE_ORDER_MARK || value == BYTE_ORDER_MARK_SWAPPED)
+	{
+	  slice->marked = true;
+	  break;
+	}
+      counts[value]++;
+    }
+
+  return NULL;
 }
 
+/*--------------------------------------------------------------------.
+| Add to COUNTS all UCS-2 characters of the input of SUBTASK, when it |
+| lies in memory and is large enough to share between threads, and    |
+| consume that input.  Otherwise, or if any byte order mark gets in   |
+| the way, leave the input alone for the caller to count serially.    |
+| Return false only if memory is exhausted.                           |
+`--------------------------------------------------------------------*/
+
 static bool
-ucs2_to_count_compare (const void *void_first, const void *void_second)
+count_in_parallel (RECODE_SUBTASK subtask, unsigned long *counts)
 {
-  const struct ucs2_to_count *first
-    = (const struct ucs2_to_count *) void_first;
-  const struct ucs2_to_count *second
-    = (const struct ucs2_to_count *) void_second;
+  RECODE_OUTER outer = subtask->task->request->outer;
+  struct count_slice slices[COUNT_THREAD_MAX];
+  gl_thread_t threads[COUNT_THREAD_MAX];
+  bool started[COUNT_THREAD_MAX];
+  const unsigned char *cursor;
+  size_t size;
+  size_t slice_size;
+  unsigned thread_count;
+  unsigned counter;
+  bool marked = false;
 
-  return first->code == second->code;
-}
+  if (!BLOCK_INPUT (subtask))
+    return true;
 
-static int
-compare_item (const void *void_first, const void *void_second)
-{
-  struct ucs2_to_count *const *first
-    = (struct ucs2_to_count *const *) void_first;
-  struct ucs2_to_count *const *second
-    = (struct ucs2_to_count *const *) void_second;
+  size = (subtask->input.limit - subtask->input.cursor) & ~(size_t) 1;
+  thread_count = MIN (num_processors (NPROC_CURRENT), COUNT_THREAD_MAX);
+  thread_count = MIN (thread_count, size / COUNT_SLICE_SIZE);
+  if (thread_count < 2)
+    return true;
+
+  if (!ALLOC (slices[0].counts, thread_count * UCS2_COUNT, unsigned long))
+    return false;
+  memset (slices[0].counts, 0,
+	  thread_count * UCS2_COUNT * sizeof (unsigned long));
+
+  /* Cut slices on an even number of bytes, the last taking the rest.  */
+
+  slice_size = (size / thread_count) & ~(size_t) 1;
+  cursor = (const unsigned char *) subtask->input.cursor;
+  for (counter = 0; counter < thread_count; counter++)
+    {
+      struct count_slice *slice = slices + counter;
+
+      slice->cursor = cursor;
+      cursor += slice_size;
+      slice->limit = (counter == thread_count - 1
+		      ? (const unsigned char *) subtask->input.cursor + size
+		      : cursor);
+      slice->swap = subtask->task->swap_input == RECODE_SWAP_YES;
+      slice->marked = false;
+      slice->counts = slices[0].counts + counter * UCS2_COUNT;
+    }
 
-  return (*first)->code - (*second)->code;
+  /* The current thread counts the first slice.  A slice for which no
+     thread could be started gets counted here as well.  */
+
+  for (counter = 1; counter < thread_count; counter++)
+    started[counter]
+      = glthread_create (threads + counter, count_slice, slices + counter) == 0;
+  count_slice (slices);
+  for (counter = 1; counter < thread_count; counter++)
+    if (started[counter])
+      gl_thread_join (threads[counter], NULL);
+    else
+      count_slice (slices + counter);
+
+  /* Merge histograms, unless counting has to restart serially.  */
+
+  for (counter = 0; counter < thread_count; counter++)
+    if (slices[counter].marked)
+      marked = true;
+
+  if (!marked)
+    {
+      for (counter = 0; counter < thread_count; counter++)
+	{
+	  const unsigned long *slice_counts = slices[counter].counts;
+	  unsigned value;
+
+	  for (value = 0; value < UCS2_COUNT; value++)
+	    counts[value] += slice_counts[value];
+	}
+      subtask->input.cursor += size;
+    }
+
+  recode_free (outer, slices[0].counts);
+  return true;
 }
 
 static void
@@ -163,86 +267,58 @@ static bool
 produce_count (RECODE_SUBTASK subtask)
 {
   RECODE_OUTER outer = subtask->task->request->outer;
-  Hash_table *table;		/* hash table for UCS-2 characters */
-  size_t size;			/* number of different characters */
-  struct ucs2_to_count **array;	/* array into hash table items */
+  unsigned long *counts;	/* count for each UCS-2 character */
 
-  table = hash_initialize (0, NULL,
-			   ucs2_to_count_hash, ucs2_to_count_compare, free);
-  if (!table)
+  if (!ALLOC (counts, UCS2_COUNT, unsigned long))
     return false;
+  memset (counts, 0, UCS2_COUNT * sizeof (unsigned long));
 
-  /* Count characters.  */
+  /* Count characters.  The first one settles the byte order, so the
+     bulk of a text in memory may then be shared between threads.  */
 
   {
     unsigned character;		/* current character being counted */
 
-    while (recode_get_ucs2 (&character, subtask))
+    if (recode_get_ucs2 (&character, subtask))
       {
-	struct ucs2_to_count lookup;
-	struct ucs2_to_count *entry;
-
-	lookup.code = character;
-	entry = (struct ucs2_to_count *) hash_lookup (table, &lookup);
-	if (entry)
-	  entry->count++;
-	else
+	counts[character]++;
+	if (!count_in_parallel (subtask, counts))
 	  {
-	    if (!ALLOC (entry, 1, struct ucs2_to_count))
-	      {
-		hash_free (table);
-		return false;
-	      }
-	    entry->code = character;
-	    entry->count = 1;
-	    if (!hash_insert (table, entry))
-	      {
-		hash_free (table);
-		free (entry);
-		return false;
-	      }
+	    recode_free (outer, counts);
+	    return false;
 	  }
+	while (recode_get_ucs2 (&character, subtask))
+	  counts[character]++;
       }
   }
 
-  /* Sort results.  */
-
-  size = hash_get_n_entries (table);
-
-  if (!ALLOC (array, size, struct ucs2_to_count *))
-    {
-      hash_free (table);
-      return false;
-    }
-  hash_get_entries (table, (void **) array, size);
-
-  qsort (array, size, sizeof (struct ucs2_to_count *), compare_item);
-
-  /* Produce the report.  */
+  /* Produce the report, by increasing UCS-2 value.  */
 
   /* FIXME: Produce it column-wise.  (See transp.c).  */
 
   {
     const unsigned non_count_width = 12;
-    struct ucs2_to_count **cursor;
-    char *buffer;
+    /* Room for a count, two spaces, four hex digits and a NUL.  */
+    char buffer[3 * sizeof (unsigned long) + 8];
     unsigned count_width;
-    unsigned maximum_count = 0;
+    unsigned long maximum_count = 0;
     unsigned column = 0;
     unsigned delayed = 0;
+    unsigned character;
 
-    for (cursor = array; cursor < array + size; cursor++)
-      if ((*cursor)->count > maximum_count)
-	maximum_count = (*cursor)->count;
-    if (asprintf (&buffer, "%u", maximum_count) == -1)
-      return false;
+    for (character = 0; character < UCS2_COUNT; character++)
+      if (counts[character] > maximum_count)
+	maximum_count = counts[character];
+    snprintf (buffer, sizeof buffer, "%lu", maximum_count);
     count_width = strlen (buffer);
-    free (buffer);
 
-    for (cursor = array; cursor < array + size; cursor++)
+    for (character = 0; character < UCS2_COUNT; character++)
       {
-	unsigned character = (*cursor)->code;
-	const char *mnemonic = recode_ucs2_to_rfc1345 (character);
+	const char *mnemonic;
+
+	if (!counts[character])
+	  continue;
+	mnemonic = recode_ucs2_to_rfc1345 (character);
 
 	if (column + count_width + non_count_width > 80)
 	  {
@@ -257,10 +333,9 @@ produce_count (RECODE_SUBTASK subtask)
 	      delayed--;
 	    }
 
-	if (asprintf (&buffer, "%*u  %.4X", (int)count_width, (*cursor)->count, character) == -1)
-          return false;
+	snprintf (buffer, sizeof buffer, "%*lu  %.4X",
+		  (int)count_width, counts[character], character);
         put_string (buffer, subtask);
-        free (buffer);
 	if (mnemonic)
 	  {
 	    recode_put_byte (' ', subtask);
@@ -279,8 +354,7 @@ produce_count (RECODE_SUBTASK subtask)
 
   /* Clean-up.  */
 
-  free (array);
-  hash_free (table);
+  recode_free (outer, counts);
 
   SUBTASK_RETURN (subtask);
 }
@@ -300,6 +374,7 @@ produce_full_dump (RECODE_SUBTASK subtask)
     {
       bool french = recode_should_prefer_french();
       const char *charname;	/* charname for code */
+      char charname_buffer[RECODE_CHARNAME_SIZE];
       char buffer[50];
 
       put_string (_("UCS2   Mne   Description\n\n"), subtask);
@@ -320,15 +395,17 @@ produce_full_dump (RECODE_SUBTASK subtask)
 
 	  if (french)
 	    {
-	      charname = recode_ucs2_to_french_charname (character);
+	      charname = recode_ucs2_to_french_charname_r (character,
+							    charname_buffer);
 	      if (!charname)
-		charname = recode_ucs2_to_charname (character);
+		charname = recode_ucs2_to_charname_r (character, charname_buffer);
 	    }
 	  else
 	    {
-	      charname = recode_ucs2_to_charname (character);
+	      charname = recode_ucs2_to_charname_r (character, charname_buffer);
 	      if (!charname)
-		charname = recode_ucs2_to_french_charname (character);
+		charname = recode_ucs2_to_french_charname_r (character,
+							      charname_buffer);
 	    }
 
 	  if (charname)
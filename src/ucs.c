@@ -21,6 +21,8 @@
 #include "common.h"
 #include "decsteps.h"
 
+#include "minmax.h"
+
 /* Description of some UCS-2 combinings.  */
 
 #define DONE NOT_A_CHARACTER
@@ -361,6 +363,38 @@ static const unsigned short combining_data [] =
 
 /* UCS-2 input and output.  */
 
+/*------------------------------------------------------------------------.
+| Normalize in bulk the byte-swapped UCS-2 input of SUBTASK which follows |
+| its cursor, stopping short of any byte order mark, either straight or   |
+| swapped, as it would change the byte order.  Return false if nothing    |
+| could be normalized.                                                    |
+`------------------------------------------------------------------------*/
+
+static bool
+swap_ucs2_block (RECODE_SUBTASK subtask)
+{
+  const char *cursor = subtask->input.cursor;
+  const char *swapped = subtask->swapped;
+  size_t size = MIN ((size_t) (subtask->input.limit - cursor) / 2 * 2,
+		     sizeof subtask->swapped);
+  size_t counter;
+
+  recode_swap_pairs (subtask->swapped, cursor, size);
+  for (counter = 0; counter < size; counter += 2)
+    {
+      unsigned chunk = ((BIT_MASK (8) & swapped[counter]) << 8
+			| (BIT_MASK (8) & swapped[counter + 1]));
+
+      if (chunk == BYTE_ORDER_MARK || chunk == BYTE_ORDER_MARK_SWAPPED)
+	break;
+    }
+
+  subtask->swapped_cursor = cursor;
+  subtask->swapped_index = 0;
+  subtask->swapped_length = counter;
+  return counter > 0;
+}
+
 /*-------------------------------------------------------------------------.
 | Get one UCS-2 VALUE for TASK, maybe swapping pair of bytes as we go.     |
 | Whenever a byte order mark is seen, either straight or swapped, always   |
@@ -384,14 +418,48 @@ recode_get_ucs2 (unsigned *value, RECODE_SUBTASK subtask)
       int character2;
       unsigned chunk;
 
-      character1 = recode_get_byte (subtask);
-      if (character1 == EOF)
-	return false;
-      character2 = recode_get_byte (subtask);
-      if (character2 == EOF)
+      /* Once input is known to be byte-swapped, normalize it in bulk.  */
+
+      if (subtask->task->swap_input == RECODE_SWAP_YES
+	  && BLOCK_INPUT (subtask)
+	  && ((subtask->swapped_index < subtask->swapped_length
+	       && subtask->input.cursor == subtask->swapped_cursor)
+	      || swap_ucs2_block (subtask)))
+	{
+	  const char *swapped = subtask->swapped + subtask->swapped_index;
+
+	  *value = (((BIT_MASK (8) & swapped[0]) << 8)
+		    | (BIT_MASK (8) & swapped[1]));
+	  subtask->swapped_index += 2;
+	  subtask->swapped_cursor += 2;
+	  subtask->input.cursor += 2;
+	  return true;
+	}
+
+      /* Otherwise, or for a byte order mark, go one pair at a time.  A
+	 change in byte order voids what was normalized beforehand.  */
+
+      subtask->swapped_length = 0;
+      if (BLOCK_INPUT (subtask)
+	  && subtask->input.limit - subtask->input.cursor >= 2)
 	{
-	  recode_if_nogo (RECODE_INVALID_INPUT, subtask);
-	  return false;
+	  /* Take both bytes at once from memory.  */
+
+	  character1 = (unsigned char) subtask->input.cursor[0];
+	  character2 = (unsigned char) subtask->input.cursor[1];
+	  subtask->input.cursor += 2;
+	}
+      else
+	{
+	  character1 = recode_get_byte (subtask);
+	  if (character1 == EOF)
+	    return false;
+	  character2 = recode_get_byte (subtask);
+	  if (character2 == EOF)
+	    {
+	      recode_if_nogo (RECODE_INVALID_INPUT, subtask);
+	      return false;
+	    }
 	}
 
       switch (subtask->task->swap_input)
@@ -29,6 +29,7 @@ Output selection:
   -n   Produce C inclusion file for character names (charname.h)
   -p   Produce C source files for strip data (strip-pool.c and strip-data.c)
   -t   Produce Texinfo inclusion file for RFC 1345 (rfc1345.texi)
+  -x   Produce C inclusion file for HTML entities (htmlentity.h)
 
 Modality options:
   -C DIRECTORY   Change to DIRECTORY prior to processing
@@ -51,6 +52,7 @@ NOT_A_CHARACTER = 0xFFFF
 class Main:
     directory = None
     charnames = None
+    entities = None
     explodes = None
     iconv = None
     mnemonics = None
@@ -63,7 +65,7 @@ class Main:
             return
         import getopt
         French_option = False
-        options, arguments = getopt.getopt(arguments, 'C:Feimnptv')
+        options, arguments = getopt.getopt(arguments, 'C:Feimnptvx')
         for option, value in options:
             if option == '-C':
                 self.directory = value
@@ -95,6 +97,10 @@ class Main:
                 self.strips.do_texinfo = True
             elif option == '-v':
                 self.verbose = True
+            elif option == '-x':
+                if not self.entities:
+                    self.entities = Entities()
+                self.entities.do_sources = True
 
         # Read all data tables.
         if self.directory:
@@ -102,6 +108,8 @@ class Main:
             os.chdir(self.directory)
         if self.iconv:
             self.iconv.digest()
+        if self.entities:
+            self.entities.digest()
         for name in arguments:
             input = Input(name)
             while True:
@@ -171,6 +179,7 @@ class Main:
                          self.strips,
                          self.charnames,
                          self.iconv,
+                         self.entities,
                          self.mnemonics):
             if instance:
                 instance.complete(French_option)
@@ -183,6 +192,61 @@ class Options:
     def __init__(self):
         self.do_sources = False
         self.do_texinfo = False
+
+    # Write a table of short integers, ten per line.
+    def write_shorts(self, write, values, format):
+        for counter, value in enumerate(values):
+            if counter % 10 == 0:
+                if counter != 0:
+                    write(',')
+                write('\n    /* %4d */ ' % counter)
+            else:
+                write(', ')
+            write(format % value)
+
+    # Same as the FNV-1a name hashing in `html.c' and `rfc1345.c'.
+    def hash(self, name):
+        value = 2166136261
+        for byte in name.encode('ascii'):
+            value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+        return value
+
+    # Mix a name hash with a seed into one of 2**SLOT_BITS slots, as the
+    # C code does.
+    def slot(self, value, seed):
+        return ((((value ^ seed) * 2654435761) & 0xFFFFFFFF)
+                >> (32 - self.SLOT_BITS))
+
+    # Build a perfect hash for DATA, a list of (index, name).  Names go
+    # into BUCKET_COUNT buckets after their hash, and each bucket, largest
+    # first, gets the first seed sending all its names to free slots.
+    # Return the seed of each bucket and the index held in each slot.
+    def perfect_hash(self, data, what):
+        buckets = [[] for counter in range(self.BUCKET_COUNT)]
+        for index, name in data:
+            value = self.hash(name)
+            buckets[value % self.BUCKET_COUNT].append((index, value))
+        order = list(range(self.BUCKET_COUNT))
+        order.sort(key=lambda bucket: -len(buckets[bucket]))
+        seeds = [0] * self.BUCKET_COUNT
+        slots = [-1] * (1 << self.SLOT_BITS)
+        for bucket in order:
+            for seed in range(1 << 16):
+                wanted = set()
+                for index, value in buckets[bucket]:
+                    slot = self.slot(value, seed)
+                    if slots[slot] >= 0 or slot in wanted:
+                        break
+                    wanted.add(slot)
+                else:
+                    break
+            else:
+                sys.stderr.write("Cannot hash %s\n" % what)
+                sys.exit(1)
+            seeds[bucket] = seed
+            for index, value in buckets[bucket]:
+                slots[self.slot(value, seed)] = index
+        return seeds, slots
 
 # Charnames.
 
@@ -400,6 +464,35 @@ class Charnames(Options):
                     sys.stdout.write('??? %s\n' % word)
             write('"},\n')
         write('  };\n')
+        # Codes are split into a page of 256 codes and a cell within it.
+        # Each page with names gets a row of cells, row 0 being empty.
+        # A cell gives the index of the name in `charname', or -1.
+        pages = [0] * 256
+        rows = [[-1] * 256]
+        for index, ucs2 in enumerate(ucs2_table):
+            if not pages[ucs2 >> 8]:
+                pages[ucs2 >> 8] = len(rows)
+                rows.append([-1] * 256)
+            rows[pages[ucs2 >> 8]][ucs2 & 0xFF] = index
+        write('\n'
+              '#define CHARNAME_ROW_COUNT %d\n'
+              % len(rows))
+        write('\n'
+              'static const unsigned char charname_page[256] =\n'
+              '  {')
+        self.write_shorts(write, pages, '%2d')
+        write('\n'
+              '  };\n')
+        write('\n'
+              'static const short charname_row[CHARNAME_ROW_COUNT][256] =\n'
+              '  {\n')
+        for counter, row in enumerate(rows):
+            write('    /* Row %d */\n'
+                  '    {' % counter)
+            self.write_shorts(write, row, '%5d')
+            write('\n'
+                  '    }%s\n' % (',' if counter < len(rows) - 1 else ''))
+        write('  };\n')
 
 # Explodes.
 
@@ -447,6 +540,117 @@ class Explodes(Options):
               '{\n'
               '}\n')
 
+# HTML entities.
+
+class Entities(Options):
+    SOURCES = 'htmlentity.h'
+
+    # Entity names are hashed into a table of 2**SLOT_BITS slots, through
+    # one of BUCKET_COUNT seeds selected by a first hash of the name.
+    SLOT_BITS = 9
+    BUCKET_COUNT = 128
+
+    # Index in `translations', code and name of each usable entity.
+    data = []
+
+    # Number of entries in `translations', including its sentinel.
+    translation_count = 0
+
+    # Read the `translations' table straight out of `html.c'.
+    def digest(self):
+        input = Input('html.c')
+        index = 0
+        while True:
+            line = input.readline()
+            if not line:
+                break
+            if not input.begins('    ENTRY ('):
+                continue
+            match = input.match(
+                r' *ENTRY \( *([0-9]+), *"([A-Za-z0-9]+)", *(.*)\)')
+            # Entries belonging to no HTML version are never looked up.
+            if match and 'V' in match.group(3):
+                self.data.append((index, int(match.group(1)),
+                                  match.group(2)))
+            index += 1
+        self.translation_count = index
+
+    def complete(self, french):
+        if self.do_sources:
+            self.complete_sources()
+
+    # Write the perfect hash of entity names, then the index of entities
+    # by code.
+    def complete_sources(self):
+        write = Output(self.SOURCES).write
+        self.complete_names(write)
+        self.complete_codes(write)
+
+    def complete_names(self, write):
+        seeds, slots = self.perfect_hash(
+            [(index, name) for index, code, name in self.data],
+            'HTML entities')
+        write('\n'
+              '#define ENTITY_SLOT_BITS %d\n'
+              '#define ENTITY_BUCKET_COUNT %d\n'
+              % (self.SLOT_BITS, self.BUCKET_COUNT))
+        write('\n'
+              'static const unsigned short entity_seed[ENTITY_BUCKET_COUNT] =\n'
+              '  {')
+        self.write_shorts(write, seeds, '%5d')
+        write('\n'
+              '  };\n')
+        write('\n'
+              'static const short entity_slot[1 << ENTITY_SLOT_BITS] =\n'
+              '  {')
+        self.write_shorts(write, slots, '%4d')
+        write('\n'
+              '  };\n')
+
+    # Codes are split into a page of 256 codes and a cell within it.
+    # Each page with entities gets a row of cells, row 0 being empty.
+    # A cell gives the first entity in `translations' for its code, and
+    # `entity_next' chains the others for the same code, if any.
+    def complete_codes(self, write):
+        pages = [0] * 256
+        rows = [[-1] * 256]
+        next = [-1] * self.translation_count
+        last = {}
+        for index, code, name in self.data:
+            if not pages[code >> 8]:
+                pages[code >> 8] = len(rows)
+                rows.append([-1] * 256)
+            if code in last:
+                next[last[code]] = index
+            else:
+                rows[pages[code >> 8]][code & 0xFF] = index
+            last[code] = index
+        write('\n'
+              '#define ENTITY_ROW_COUNT %d\n'
+              % len(rows))
+        write('\n'
+              'static const unsigned char entity_page[256] =\n'
+              '  {')
+        self.write_shorts(write, pages, '%2d')
+        write('\n'
+              '  };\n')
+        write('\n'
+              'static const short entity_row[ENTITY_ROW_COUNT][256] =\n'
+              '  {\n')
+        for counter, row in enumerate(rows):
+            write('    /* Row %d */\n'
+                  '    {' % counter)
+            self.write_shorts(write, row, '%4d')
+            write('\n'
+                  '    }%s\n' % (',' if counter < len(rows) - 1 else ''))
+        write('  };\n')
+        write('\n'
+              'static const short entity_next[%d] =\n'
+              '  {' % self.translation_count)
+        self.write_shorts(write, next, '%4d')
+        write('\n'
+              '  };\n')
+
 # Iconv.
 
 class Iconv(Options):
@@ -522,6 +726,11 @@ class Mnemonics(Options):
     # Ignore any mnemonic whose length is greater than MAX_MNEMONIC_LENGTH.
     MAX_MNEMONIC_LENGTH = 3
 
+    # Mnemonics are hashed into a table of 2**SLOT_BITS slots, through one
+    # of BUCKET_COUNT seeds selected by a first hash of the mnemonic.
+    SLOT_BITS = 12
+    BUCKET_COUNT = 512
+
     # Numeric value of a character, given its mnemonic.
     ucs2_map = {}
 
@@ -656,7 +865,8 @@ class Mnemonics(Options):
         if self.do_sources:
             self.complete_sources()
 
-    # Write an UCS-2 to RFC 1345 mnemonic table.
+    # Write an UCS-2 to RFC 1345 mnemonic table, then the perfect hash of
+    # mnemonics and the index of mnemonics by code.
     def complete_sources(self):
         inverse_map = {}
         write = Output(self.SOURCES).write
@@ -683,24 +893,61 @@ class Mnemonics(Options):
                   % (count, ucs2, re.sub(r'([\"])', r'\\\1', text)))
             count += 1
         write('  };\n')
+        self.complete_names(write, inverse_map)
+        self.complete_codes(write, indices)
 
+    def complete_names(self, write, inverse_map):
+        seeds, slots = self.perfect_hash(
+            [(index, text) for text, index in sorted(inverse_map.items())],
+            'RFC 1345 mnemonics')
         write('\n'
-              'static const unsigned short inverse[TABLE_LENGTH] =\n'
+              '#define MNEMONIC_SLOT_BITS %d\n'
+              '#define MNEMONIC_BUCKET_COUNT %d\n'
+              % (self.SLOT_BITS, self.BUCKET_COUNT))
+        write('\n'
+              'static const unsigned short mnemonic_seed'
+              '[MNEMONIC_BUCKET_COUNT] =\n'
               '  {')
-        count = 0
-        keys = list(inverse_map.keys())
-        keys.sort()
-        for text in keys:
-            if count % 10 == 0:
-                if count != 0:
-                    write(',')
-                write('\n    /* %4d */ ' % count)
-            else:
-                write(', ')
-            write('%4d' % inverse_map[text])
-            count += 1
+        self.write_shorts(write, seeds, '%5d')
+        write('\n'
+              '  };\n')
+        write('\n'
+              'static const short mnemonic_slot[1 << MNEMONIC_SLOT_BITS] =\n'
+              '  {')
+        self.write_shorts(write, slots, '%4d')
         write('\n'
               '  };\n')
+
+    # Codes are split into a page of 256 codes and a cell within it.  Each
+    # page with mnemonics gets a row of cells, row 0 being empty.  A cell
+    # gives the index in `table' of the mnemonic for its code.
+    def complete_codes(self, write, indices):
+        pages = [0] * 256
+        rows = [[-1] * 256]
+        for index, ucs2 in enumerate(indices):
+            if not pages[ucs2 >> 8]:
+                pages[ucs2 >> 8] = len(rows)
+                rows.append([-1] * 256)
+            rows[pages[ucs2 >> 8]][ucs2 & 0xFF] = index
+        write('\n'
+              '#define MNEMONIC_ROW_COUNT %d\n'
+              % len(rows))
+        write('\n'
+              'static const unsigned char mnemonic_page[256] =\n'
+              '  {')
+        self.write_shorts(write, pages, '%2d')
+        write('\n'
+              '  };\n')
+        write('\n'
+              'static const short mnemonic_row[MNEMONIC_ROW_COUNT][256] =\n'
+              '  {\n')
+        for counter, row in enumerate(rows):
+            write('    /* Row %d */\n'
+                  '    {' % counter)
+            self.write_shorts(write, row, '%4d')
+            write('\n'
+                  '    }%s\n' % (',' if counter < len(rows) - 1 else ''))
+        write('  };\n')
 
 # Global table of strips.
 
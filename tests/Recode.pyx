@@ -17,7 +17,7 @@
 # along with this program; if not, see <https://www.gnu.org/licenses/>.
 
 from libcpp cimport bool
-from libc.stdlib cimport free
+from libc.stdlib cimport malloc, free
 from libc.stdio cimport FILE
 
 cdef extern from "common.h":
@@ -188,9 +188,18 @@ cdef extern from "common.h":
         recode_error_ abort_level
         recode_error_ error_so_far
         RECODE_CONST_STEP error_at_step
+        size_t error_at_offset
+        bool reference_path
     ctypedef recode_task *RECODE_TASK
     ctypedef recode_task *RECODE_CONST_TASK
 
+    struct recode_arena:
+        pass
+
+    struct recode_span:
+        char *buffer
+        size_t size
+
     struct recode_subtask:
         RECODE_TASK task
         RECODE_CONST_STEP step
@@ -287,6 +296,9 @@ cdef extern from "common.h":
     void recode_perror(RECODE_OUTER, char *, ...)
     void *recode_malloc(RECODE_OUTER, size_t)
     void *recode_realloc(RECODE_OUTER, void *, size_t)
+    void recode_free(RECODE_OUTER, void *)
+    recode_arena *recode_new_arena(RECODE_OUTER, size_t)
+    void recode_delete_arena(recode_arena *)
 
     unsigned char *invert_table(RECODE_OUTER, unsigned char *)
     bool complete_pairs(RECODE_OUTER, RECODE_STEP,
@@ -432,16 +444,22 @@ cdef extern from "common.h":
             RECODE_REQUEST, recode_programming_language, char *)
     bool recode_buffer_to_buffer(
             RECODE_CONST_REQUEST, char *, size_t, char **, size_t *, size_t *)
+    bool recode_buffer_preflight(
+            RECODE_CONST_REQUEST, char *, size_t, size_t *)
     bool recode_buffer_to_file(
             RECODE_CONST_REQUEST, char *, size_t, FILE *)
     bool recode_file_to_buffer(
             RECODE_CONST_REQUEST, FILE *, char **, size_t *, size_t *)
     bool recode_file_to_file(RECODE_CONST_REQUEST, FILE *, FILE *)
+    char *recode_buffers_batch(
+            RECODE_CONST_REQUEST, recode_span *, size_t, recode_arena *,
+            size_t *, recode_error_ *)
 
     # Recode library at TASK level.
 
     RECODE_TASK recode_new_task(RECODE_CONST_REQUEST)
     bool recode_delete_task(RECODE_TASK)
+    bool recode_task_reset(RECODE_TASK)
     bool recode_perform_task(RECODE_TASK)
 
 class error(Exception):
@@ -614,6 +632,13 @@ cdef class Request:
             list.append((step.before.name, step.after.name))
         return list
 
+    def step_types(self):
+        list = []
+        cdef short counter
+        for counter from 0 <= counter < self.request.sequence_length:
+            list.append(self.request.sequence_array[counter].step_type)
+        return list
+
     def format_table(self, int language, char *charset):
         cdef RECODE_OUTER outer
         cdef bool saved
@@ -641,6 +666,62 @@ cdef class Request:
             free (output)
         return py_string
 
+    def string_into(self, text, size_t size):
+        # Recode TEXT into a buffer of SIZE bytes given beforehand.  Return
+        # the output, and whether the buffer had to move or to grow.
+        cdef char *input = text
+        cdef size_t input_len = len(text)
+        cdef RECODE_OUTER outer = self.request.outer
+        cdef char *buffer = <char *> recode_malloc(outer, size)
+        cdef char *output = buffer
+        cdef size_t output_len
+        cdef size_t output_allocated = size
+        if buffer is NULL:
+            raise error
+        result = recode_buffer_to_buffer(self.request, input, input_len, &output, &output_len, &output_allocated)
+        if result is False or output is NULL:
+            recode_free(outer, output)
+            raise error
+        try:
+            py_string = output[:output_len]
+        finally:
+            recode_free(outer, output)
+        return py_string, output != buffer, output_allocated != size
+
+    def preflight(self, text):
+        cdef char *input = text
+        cdef size_t input_len = len(text)
+        cdef size_t output_len
+        result = recode_buffer_preflight(self.request, input, input_len, &output_len)
+        if result is False:
+            raise error
+        return output_len
+
+    def batch(self, texts):
+        cdef size_t n = len(texts)
+        cdef recode_span *spans = <recode_span *> malloc((n + 1) * sizeof(recode_span))
+        cdef size_t *offsets = <size_t *> malloc((n + 1) * sizeof(size_t))
+        cdef recode_error_ *errors = <recode_error_ *> malloc((n + 1) * sizeof(recode_error_))
+        cdef recode_arena *arena = recode_new_arena(self.request.outer, 0)
+        cdef char *output
+        cdef size_t counter
+        try:
+            for counter from 0 <= counter < n:
+                spans[counter].buffer = texts[counter]
+                spans[counter].size = len(texts[counter])
+            output = recode_buffers_batch(
+                    self.request, spans, n, arena, offsets, errors)
+            if output is NULL:
+                raise error
+            return [(output[offsets[counter]:offsets[counter + 1]],
+                     errors[counter])
+                    for counter in range(n)]
+        finally:
+            recode_delete_arena(arena)
+            free(errors)
+            free(offsets)
+            free(spans)
+
     # Unexposed APIs:
 
     # Don't expose recode_string; always check return value
@@ -705,3 +786,6 @@ cdef class Task:
 
     def perform(self):
         return recode_perform_task(self.task)
+
+    def reset(self):
+        return recode_task_reset(self.task)
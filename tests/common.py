@@ -62,6 +62,18 @@ def external_output(command):
     # FIXME: Find a more portable solution than checking the OS
     return subprocess.check_output(command, universal_newlines=True, shell=os.name != 'nt')
 
+def external_status(command):
+    # Return the exit status and the standard error of COMMAND.
+    if not recode_program:
+        py.test.skip()
+    command = command.replace('$R', recode_program)
+    process = subprocess.Popen(command, universal_newlines=True,
+                               shell=os.name != 'nt',
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.PIPE)
+    errors = process.communicate()[1]
+    return process.returncode, errors
+
 def recode_output(input, encoding='utf-8'):
     if type(input) != bytes:
         input = bytes(input, encoding)
@@ -0,0 +1,722 @@
+/* Differential checking of Recode block kernels.
+   Copyright © 2026 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Each request below is performed twice over the same input: once through
+   the reference byte path (the task having `reference_path' set), and once
+   through whatever block kernels the library may use.  The output texts,
+   the maximum error levels, the steps where these errors were met and
+   their input offsets should all agree.
+
+   Without arguments, a deterministic pseudo-random corpus is run through
+   all requests, and the throughput of both paths is reported alongside.
+   Arguments may restrict the checking to some requests only.  Options are:
+
+     -n COUNT   Try COUNT inputs of each shape, instead of 40.
+     -q         Do not report throughputs.
+     -s SEED    Use SEED for generating the corpus, instead of 1.
+
+   When compiled with -DRECODE_FUZZER and linked with -fsanitize=fuzzer,
+   this file rather provides a libFuzzer target.  The first byte of each
+   fuzzer input then selects the request, the remaining bytes are recoded.
+   Any disagreement aborts the program.
+
+   All library memory is obtained through counting allocation hooks, so
+   memory leaks get reported as well.  */
+
+#include "config.h"
+#include "common.h"
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+const char *program_name = "kernels";
+
+/* Requests to check, chosen to cover all steps having block kernels.  */
+
+static const char *const request_strings[] =
+  {
+    /* Byte to byte tables, merged or not.  */
+    "Latin-1..IBM-PC",
+    "IBM-PC..Latin-1",
+    "Latin-1..ISO-8859-2",
+    "Latin-1..EBCDIC..IBM-PC",
+
+    /* Byte to variable tables, UCS and UTF.  */
+    "Latin-1..UTF-8",
+    "UTF-8..Latin-1",
+    "UTF-8..UCS-2",
+    "UCS-2..UTF-8",
+    "UTF-16..UTF-8",
+    "UTF-8..UTF-16",
+    "UCS-2..UCS-4",
+
+    /* Surfaces.  */
+    "../Base64",
+    "/Base64..",
+    "../Quoted-Printable",
+    "/Quoted-Printable..",
+    "../CR",
+    "/CR..",
+    "../CR-LF",
+    "/CR-LF..",
+    "../21",
+    "/21..",
+    "../4321",
+    "/4321..",
+    "../x1",
+    "../x2",
+    "../d4",
+    "../o2",
+    "/x1..",
+    "/x2..",
+    "/d1..",
+    "/o4..",
+    "Latin-1..UTF-8/Base64",
+
+    /* Entities, combining and exploding, mnemonics.  */
+    "HTML..UTF-8",
+    "UTF-8..HTML",
+    "UCS-2..HTML_1.1",
+    "VISCII..VIQR",
+    "VIQR..VISCII",
+    "Latin-1..Texinfo",
+    "Texinfo..Latin-1",
+    "UTF-8..RFC1345",
+    "RFC1345..UTF-8",
+  };
+
+#define NUMBER_OF_REQUESTS \
+  (sizeof request_strings / sizeof request_strings[0])
+
+static RECODE_OUTER outer;
+static RECODE_REQUEST request_array[NUMBER_OF_REQUESTS];
+
+/* Allocation hooks.  */
+
+static size_t outstanding_blocks;
+
+static void *
+counting_allocate (_GL_UNUSED void *closure, size_t size)
+{
+  void *result = malloc (size);
+
+  if (result)
+    outstanding_blocks++;
+  return result;
+}
+
+static void *
+counting_reallocate (_GL_UNUSED void *closure, void *pointer, size_t size)
+{
+  void *result = realloc (pointer, size);
+
+  if (result && !pointer)
+    outstanding_blocks++;
+  return result;
+}
+
+static void
+counting_release (_GL_UNUSED void *closure, void *pointer)
+{
+  if (pointer)
+    outstanding_blocks--;
+  free (pointer);
+}
+
+static const struct recode_allocator counting_allocator =
+  {
+    counting_allocate,
+    counting_reallocate,
+    counting_release,
+    NULL
+  };
+
+/* Pseudo-random generation.  */
+
+static uint64_t random_state = 1;
+
+static unsigned
+next_random (void)
+{
+  /* This is xorshift64*, good enough and the same everywhere.  */
+
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return (random_state * 2685821657736338717ULL) >> 32;
+}
+
+static unsigned
+random_below (unsigned limit)
+{
+  return next_random () % limit;
+}
+
+/* Corpus generation.  */
+
+enum shape
+  {
+    RANDOM_BYTES,		/* anything at all */
+    ASCII_TEXT,			/* lines of ASCII text */
+    LATIN1_TEXT,		/* lines of Latin-1 text */
+    UTF8_TEXT,			/* UTF-8, sometimes damaged */
+    UCS2_TEXT,			/* UCS-2, with or without byte order mark */
+    BASE64_TEXT,		/* Base64 lines, sometimes damaged */
+    QUOTED_TEXT,		/* Quoted-Printable lines */
+    ENTITY_TEXT,		/* text with HTML entities */
+    DUMP_TEXT,			/* numeric dump lines */
+    NUMBER_OF_SHAPES
+  };
+
+static const char *const shape_names[NUMBER_OF_SHAPES] =
+  {
+    "random", "ascii", "latin1", "utf8", "ucs2",
+    "base64", "quoted", "entity", "dump"
+  };
+
+/* Append BYTE to the text at TEXT, of length *LENGTH, never exceeding
+   LIMIT bytes.  Return false once the text is full.  */
+
+static bool
+add_byte (char *text, size_t *length, size_t limit, int byte)
+{
+  if (*length == limit)
+    return false;
+  text[(*length)++] = byte;
+  return true;
+}
+
+static bool
+add_string (char *text, size_t *length, size_t limit, const char *string)
+{
+  while (*string)
+    if (!add_byte (text, length, limit, *string++))
+      return false;
+  return true;
+}
+
+/* Produce into TEXT about LIMIT bytes of the given SHAPE, and return the
+   actual length.  */
+
+static size_t
+generate (enum shape shape, char *text, size_t limit)
+{
+  static const char base64_digits[]
+    = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  static const char hexadecimal_digits[] = "0123456789ABCDEF";
+  static const char *const entities[] =
+    {
+      "&amp;", "&lt;", "&gt;", "&quot;", "&eacute;", "&Eacute;", "&nbsp;",
+      "&#233;", "&#xE9;", "&#x;", "&#;", "&bogus;", "&", "&#65", "&amp"
+    };
+  size_t length = 0;
+  size_t column = 0;
+  bool going = true;
+
+  switch (shape)
+    {
+    case RANDOM_BYTES:
+      while (length < limit)
+	text[length++] = random_below (256);
+      break;
+
+    case ASCII_TEXT:
+    case LATIN1_TEXT:
+      while (going)
+	{
+	  unsigned choice = random_below (100);
+	  int byte;
+
+	  if (choice < 3)
+	    byte = '\n';
+	  else if (choice < 4)
+	    byte = '\r';
+	  else if (choice < 15)
+	    byte = ' ';
+	  else if (choice < 17)
+	    byte = "=&<>\"\t"[random_below (6)];
+	  else if (shape == LATIN1_TEXT && choice < 30)
+	    byte = 160 + random_below (96);
+	  else
+	    byte = 'a' + random_below (26);
+	  going = add_byte (text, &length, limit, byte);
+	}
+      break;
+
+    case UTF8_TEXT:
+      while (going)
+	{
+	  unsigned choice = random_below (100);
+	  unsigned value;
+
+	  if (choice < 60)
+	    value = 32 + random_below (95);
+	  else if (choice < 63)
+	    value = '\n';
+	  else if (choice < 85)
+	    value = 160 + random_below (0x700);
+	  else if (choice < 97)
+	    value = 0x800 + random_below (0xF800);
+	  else
+	    {
+	      /* Some damage: a stray continuation or a truncated lead.  */
+	      going = add_byte (text, &length, limit,
+				random_below (2) ? 0x80 + random_below (64)
+				: 0xC0 + random_below (48));
+	      continue;
+	    }
+
+	  if (value < 0x80)
+	    going = add_byte (text, &length, limit, value);
+	  else if (value < 0x800)
+	    going = (add_byte (text, &length, limit, 0xC0 | value >> 6)
+		     && add_byte (text, &length, limit, 0x80 | (value & 63)));
+	  else
+	    going = (add_byte (text, &length, limit, 0xE0 | value >> 12)
+		     && add_byte (text, &length, limit,
+				  0x80 | (value >> 6 & 63))
+		     && add_byte (text, &length, limit, 0x80 | (value & 63)));
+	}
+      break;
+
+    case UCS2_TEXT:
+      switch (random_below (3))
+	{
+	case 0:
+	  going = add_string (text, &length, limit, "\376\377");
+	  break;
+
+	case 1:
+	  going = add_string (text, &length, limit, "\377\376");
+	  break;
+
+	default:
+	  break;
+	}
+      while (going)
+	{
+	  unsigned value = (random_below (4) ? 32 + random_below (224)
+			    : random_below (65536));
+
+	  going = (add_byte (text, &length, limit, value >> 8)
+		   && add_byte (text, &length, limit, value & 255));
+	}
+      break;
+
+    case BASE64_TEXT:
+      while (going)
+	{
+	  unsigned choice = random_below (1000);
+
+	  if (column == 76 || choice < 5)
+	    {
+	      going = add_byte (text, &length, limit, '\n');
+	      column = 0;
+	    }
+	  else if (choice < 7)
+	    {
+	      going = add_string (text, &length, limit,
+				  random_below (2) ? "=" : "==");
+	      column++;
+	    }
+	  else if (choice < 9)
+	    {
+	      going = add_byte (text, &length, limit, "!* \r"[random_below (4)]);
+	      column++;
+	    }
+	  else
+	    {
+	      going = add_byte (text, &length, limit,
+				base64_digits[random_below (64)]);
+	      column++;
+	    }
+	}
+      break;
+
+    case QUOTED_TEXT:
+      while (going)
+	{
+	  unsigned choice = random_below (100);
+
+	  if (choice < 3)
+	    {
+	      going = add_byte (text, &length, limit, '\n');
+	      column = 0;
+	    }
+	  else if (choice < 5 || column > 74)
+	    {
+	      going = add_string (text, &length, limit,
+				  random_below (4) ? "=\n" : " \n");
+	      column = 0;
+	    }
+	  else if (choice < 15)
+	    {
+	      going = (add_byte (text, &length, limit, '=')
+		       && add_byte (text, &length, limit,
+				    hexadecimal_digits[random_below (16)])
+		       && add_byte (text, &length, limit,
+				    random_below (20)
+				    ? hexadecimal_digits[random_below (16)]
+				    : 'z'));
+	      column += 3;
+	    }
+	  else
+	    {
+	      going = add_byte (text, &length, limit,
+				random_below (10) ? 'a' + random_below (26)
+				: ' ');
+	      column++;
+	    }
+	}
+      break;
+
+    case ENTITY_TEXT:
+      while (going)
+	if (random_below (8) == 0)
+	  going = add_string (text, &length, limit,
+			      entities[random_below (sizeof entities
+						     / sizeof entities[0])]);
+	else
+	  going = add_byte (text, &length, limit,
+			    random_below (20) ? 'a' + random_below (26) : '\n');
+      break;
+
+    case DUMP_TEXT:
+      while (going)
+	{
+	  unsigned choice = random_below (100);
+
+	  if (choice < 5)
+	    going = add_byte (text, &length, limit, '\n');
+	  else if (choice < 20)
+	    going = add_string (text, &length, limit, ", ");
+	  else if (choice < 30)
+	    going = add_string (text, &length, limit, "0x");
+	  else if (choice < 31)
+	    going = add_byte (text, &length, limit, 'g');
+	  else
+	    going = add_byte (text, &length, limit,
+			      hexadecimal_digits[random_below (16)]);
+	}
+      break;
+
+    default:
+      abort ();
+    }
+
+  return length;
+}
+
+/* Running tasks.  */
+
+struct outcome
+  {
+    bool success;		/* value returned by recode_perform_task */
+    char *output;		/* output buffer, to be freed */
+    size_t length;		/* length of output */
+    enum recode_error error;	/* maximum error level met */
+    RECODE_CONST_STEP error_at_step; /* step where error was last set */
+    size_t error_at_offset;	/* input offset where error was last set */
+  };
+
+/* Recode INPUT of LENGTH bytes through REQUEST into OUTCOME, using the
+   reference byte path if REFERENCE.  Return the elapsed time in seconds.  */
+
+static double
+perform (RECODE_CONST_REQUEST request, const char *input, size_t length,
+	 bool reference, struct outcome *outcome)
+{
+  RECODE_TASK task = recode_new_task (request);
+  struct timespec start;
+  struct timespec finish;
+
+  if (!task)
+    abort ();
+  task->reference_path = reference;
+  task->input.buffer = input;
+  task->input.cursor = input;
+  task->input.limit = input + length;
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  outcome->success = recode_perform_task (task);
+  clock_gettime (CLOCK_MONOTONIC, &finish);
+
+  outcome->output = task->output.buffer;
+  outcome->length = task->output.cursor - task->output.buffer;
+  outcome->error = task->error_so_far;
+  outcome->error_at_step = task->error_at_step;
+  outcome->error_at_offset = task->error_at_offset;
+  recode_delete_task (task);
+
+  return ((finish.tv_sec - start.tv_sec)
+	  + (finish.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+/* Report to stderr how the REFERENCE and KERNEL outcomes differ for
+   request number INDEX, and return false, or return true if they agree.
+   Use DESCRIPTION for identifying the input.  */
+
+static bool
+compare (unsigned index, const char *description,
+	 const struct outcome *reference, const struct outcome *kernel)
+{
+  RECODE_CONST_REQUEST request = request_array[index];
+  const char *problem = NULL;
+  size_t offset = 0;
+
+  if (reference->length != kernel->length
+      || memcmp (reference->output, kernel->output, reference->length) != 0)
+    {
+      while (offset < reference->length && offset < kernel->length
+	     && reference->output[offset] == kernel->output[offset])
+	offset++;
+      problem = "outputs differ";
+    }
+  else if (reference->success != kernel->success)
+    problem = "success differs";
+  else if (reference->error != kernel->error)
+    problem = "error levels differ";
+  else if (reference->error != RECODE_NO_ERROR
+	   && reference->error_at_step != kernel->error_at_step)
+    problem = "error steps differ";
+  else if (reference->error != RECODE_NO_ERROR
+	   && reference->error_at_offset != kernel->error_at_offset)
+    problem = "error offsets differ";
+
+  if (!problem)
+    return true;
+
+  fprintf (stderr, "%s: %s, %s\n", request_strings[index], description,
+	   problem);
+  if (offset)
+    fprintf (stderr, "  first difference at output offset %zu\n", offset);
+  fprintf (stderr, "  reference: %zu bytes, error %u at step %td offset %zu\n",
+	   reference->length, (unsigned) reference->error,
+	   reference->error_at_step
+	   ? reference->error_at_step - request->sequence_array : -1,
+	   reference->error_at_offset);
+  fprintf (stderr, "  kernels:   %zu bytes, error %u at step %td offset %zu\n",
+	   kernel->length, (unsigned) kernel->error,
+	   kernel->error_at_step
+	   ? kernel->error_at_step - request->sequence_array : -1,
+	   kernel->error_at_offset);
+  return false;
+}
+
+/* Check request number INDEX over INPUT of LENGTH bytes.  Accumulate
+   elapsed times into TIMES, unless NULL.  */
+
+static bool
+check (unsigned index, const char *input, size_t length,
+       const char *description, double *times)
+{
+  struct outcome reference;
+  struct outcome kernel;
+  double reference_time;
+  double kernel_time;
+  bool agree;
+
+  reference_time = perform (request_array[index], input, length, true,
+			    &reference);
+  kernel_time = perform (request_array[index], input, length, false,
+			 &kernel);
+  agree = compare (index, description, &reference, &kernel);
+  recode_free (outer, reference.output);
+  recode_free (outer, kernel.output);
+
+  if (times)
+    {
+      times[0] += reference_time;
+      times[1] += kernel_time;
+    }
+  return agree;
+}
+
+/* Prepare the library and all requests.  */
+
+static void
+prepare (void)
+{
+  unsigned index;
+
+  if (outer)
+    return;
+
+  outer = recode_new_outer_with_allocator (RECODE_NO_ICONV_FLAG,
+					   &counting_allocator);
+  if (!outer)
+    abort ();
+
+  for (index = 0; index < NUMBER_OF_REQUESTS; index++)
+    {
+      request_array[index] = recode_new_request (outer);
+      if (!request_array[index]
+	  || !recode_scan_request (request_array[index],
+				   request_strings[index]))
+	{
+	  fprintf (stderr, "%s: cannot scan request `%s'\n",
+		   program_name, request_strings[index]);
+	  exit (EXIT_FAILURE);
+	}
+    }
+}
+
+#ifdef RECODE_FUZZER
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+  if (size == 0)
+    return 0;
+
+  prepare ();
+  if (!check (data[0] % NUMBER_OF_REQUESTS, (const char *) data + 1,
+	      size - 1, "fuzzer input", NULL))
+    abort ();
+
+  return 0;
+}
+
+#else /* not RECODE_FUZZER */
+
+/* Size of the biggest input, and of the inputs used for throughput.  */
+#define SMALL_LIMIT 4096
+#define LARGE_LIMIT (1 << 18)
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned count = 40;
+  bool quiet = false;
+  bool selected[NUMBER_OF_REQUESTS];
+  bool any_selected = false;
+  unsigned failures = 0;
+  char *text;
+  unsigned index;
+  int option_char;
+
+  while (option_char = getopt (argc, argv, "n:qs:"), option_char != EOF)
+    switch (option_char)
+      {
+      case 'n':
+	count = atoi (optarg);
+	break;
+
+      case 'q':
+	quiet = true;
+	break;
+
+      case 's':
+	random_state = strtoull (optarg, NULL, 10);
+	if (random_state == 0)
+	  random_state = 1;
+	break;
+
+      default:
+	fprintf (stderr, "Usage: %s [-n COUNT] [-q] [-s SEED] [REQUEST]...\n",
+		 program_name);
+	return EXIT_FAILURE;
+      }
+
+  prepare ();
+
+  memset (selected, 0, sizeof selected);
+  for (; optind < argc; optind++)
+    {
+      for (index = 0; index < NUMBER_OF_REQUESTS; index++)
+	if (strcmp (argv[optind], request_strings[index]) == 0)
+	  break;
+      if (index == NUMBER_OF_REQUESTS)
+	{
+	  fprintf (stderr, "%s: request `%s' is not in the list\n",
+		   program_name, argv[optind]);
+	  return EXIT_FAILURE;
+	}
+      selected[index] = true;
+      any_selected = true;
+    }
+
+  text = malloc (LARGE_LIMIT);
+  if (!text)
+    abort ();
+
+  if (!quiet)
+    printf ("%-28s %12s %12s %8s\n",
+	    "Request", "Reference", "Kernels", "Speedup");
+
+  for (index = 0; index < NUMBER_OF_REQUESTS; index++)
+    {
+      double times[2] = { 0, 0 };
+      size_t total = 0;
+      enum shape shape;
+      unsigned counter;
+
+      if (any_selected && !selected[index])
+	continue;
+
+      for (shape = 0; shape < NUMBER_OF_SHAPES; shape++)
+	{
+	  /* Many short inputs, for correctness.  */
+
+	  for (counter = 0; counter < count; counter++)
+	    {
+	      char description[64];
+	      size_t length
+		= generate (shape, text,
+			    counter < 16 ? counter : random_below (SMALL_LIMIT));
+
+	      sprintf (description, "%s input of %zu bytes, number %u",
+		       shape_names[shape], length, counter);
+	      if (!check (index, text, length, description, NULL))
+		failures++;
+	    }
+
+	  /* A long input, for both correctness and throughput.  */
+
+	  {
+	    char description[64];
+	    size_t length = generate (shape, text, LARGE_LIMIT);
+
+	    sprintf (description, "long %s input", shape_names[shape]);
+	    if (!check (index, text, length, description, times))
+	      failures++;
+	    total += length;
+	  }
+	}
+
+      if (!quiet)
+	printf ("%-28s %7.1f MB/s %7.1f MB/s %7.2fx\n",
+		request_strings[index],
+		total / times[0] / 1e6, total / times[1] / 1e6,
+		times[0] / times[1]);
+    }
+
+  free (text);
+  for (index = 0; index < NUMBER_OF_REQUESTS; index++)
+    recode_delete_request (request_array[index]);
+  recode_delete_outer (outer);
+
+  if (failures)
+    fprintf (stderr, "%s: %u disagreements\n", program_name, failures);
+  if (outstanding_blocks)
+    fprintf (stderr, "%s: %zu memory blocks never freed\n", program_name,
+	     outstanding_blocks);
+  return failures || outstanding_blocks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif /* not RECODE_FUZZER */
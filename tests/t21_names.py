@@ -1,6 +1,6 @@
 # -*- coding: utf-8 -*-
 import common
-from common import setup_module, teardown_module
+from common import setup_module, teardown_module, Recode, outer
 
 # Checking list of charsets and surfaces.
 
@@ -234,3 +234,21 @@ Z39.47:1993 8bitANSEL ANSEL LOC MARC USMARC Z39.47
 def test_1():
     output = common.external_output('$R --ignore=:iconv: -l')
     common.assert_or_diff(output, expected)
+
+def test_2():
+    # Names ignore case and punctuation, and may be abbreviated as long
+    # as they stay unambiguous.
+    request = Recode.Request(outer)
+    request.scan(b'latin1..IBMPC')
+    expected = request.string(b'\351t\351')
+    for text in b'Latin-1..ibm-pc', b'LATIN1..ibmp', b'iso8859-1..IBMpc':
+        request = Recode.Request(outer)
+        request.scan(text)
+        assert request.string(b'\351t\351') == expected
+    request = Recode.Request(outer)
+    try:
+        request.scan(b'cp125..latin1')
+    except Recode.error:
+        pass
+    else:
+        assert False
@@ -1,6 +1,6 @@
 # -*- coding: utf-8 -*-
 import common
-from common import setup_module, teardown_module
+from common import setup_module, teardown_module, Recode, outer
 
 # Testing and counting.
 
@@ -59,3 +59,16 @@ class Test_test16:
     def test_1(self):
         common.request('test16..x2,us..count')
         common.validate('', self.output)
+
+class Test_large:
+
+    # Large enough for counting to be shared between threads.
+    output = '''\
+1000000  000A LF   1000000  0061 a    1000000  0062 b    1000000  0063 c
+'''
+
+    def test_1(self):
+        request = Recode.Request(outer)
+        request.scan(b'latin1..count')
+        output = request.string(b'abc\n' * 1000000)
+        assert output == bytes(self.output, 'ascii')
@@ -1,6 +1,6 @@
 # -*- coding: utf-8 -*-
 import common
-from common import setup_module, teardown_module
+from common import setup_module, teardown_module, Recode, outer, outer_iconv
 from __main__ import py
 
 import os, sys
@@ -60,3 +60,122 @@ def validate(request):
     with open(common.run.work) as f:
         output = f.read()
     common.assert_or_diff(output, input)
+
+def test_2():
+    # No step at all.
+    yield validate_preflight, 'texte..texte'
+
+    # One single step.
+    yield validate_preflight, 'latin1..ibmpc/'
+
+    # Growing output, with a surface.
+    yield validate_preflight, 'latin1..utf-16/base64'
+
+    # Two single steps.
+    yield validate_preflight, 'latin1..bangbang'
+
+def validate_preflight(request):
+    recode_request = Recode.Request(outer)
+    recode_request.scan(bytes(request, 'ascii'))
+    text = bytes(input, 'ascii')
+    output = recode_request.string(text)
+    length = recode_request.preflight(text)
+    assert length == len(output)
+
+    # A buffer sized from the preflight never needs to move nor grow.
+    output, moved, grown = recode_request.string_into(text, length + 4)
+    assert output == recode_request.string(text)
+    assert not moved
+    assert not grown
+
+def test_3():
+    # Single-byte charsets through iconv, turned into tables.
+    yield validate_iconv_table, 'IBM037/..IBM500/', 'cp037', 'cp500'
+    yield validate_iconv_table, 'IBM500/..IBM037/', 'cp500', 'cp037'
+
+def validate_iconv_table(request, before, after):
+    if outer_iconv is None:
+        py.test.skip()
+    recode_request = Recode.Request(outer_iconv)
+    recode_request.scan(bytes(request, 'ascii'))
+    assert recode_request.step_types() == [Recode.BYTE_TO_BYTE]
+    text = bytes(range(256)) * 2
+    output = recode_request.string(text)
+    assert output == text.decode(before).encode(after)
+
+def test_4():
+    # Many files recoded over themselves at once.
+    yield validate_jobs, 'latin1..ibmpc'
+    yield validate_jobs, 'latin1..utf-16/base64'
+
+def validate_jobs(request):
+    before, after = request.split('..')
+    names = ['%s-%d' % (common.run.work, counter) for counter in range(6)]
+    for counter, name in enumerate(names):
+        with open(name, 'w') as f:
+            f.write(input[counter * 1000:])
+    try:
+        command1 = ('$R --quiet --force --jobs=3 %s %s'
+                    % (request, ' '.join(names)))
+        command2 = ('$R --quiet --force --jobs=0 %s..%s %s'
+                    % (after, before, ' '.join(names)))
+        print(command1)
+        print(command2)
+        common.external_output(command1)
+        common.external_output(command2)
+        for counter, name in enumerate(names):
+            with open(name) as f:
+                output = f.read()
+            common.assert_or_diff(output, input[counter * 1000:])
+    finally:
+        for name in names:
+            if os.path.exists(name):
+                os.remove(name)
+
+def test_5():
+    # A decoder holding back a base letter, in case a combining accent
+    # follows, should not be turned into a table.
+    if outer_iconv is None:
+        py.test.skip()
+    recode_request = Recode.Request(outer_iconv)
+    recode_request.scan(b'TCVN..UTF-8')
+    if len(recode_request.pair_sequence()) != 1:
+        py.test.skip()
+    assert recode_request.step_types() == [Recode.NO_STEP_TABLE]
+    assert recode_request.string(b'a\xb0') == '\u00e0'.encode('utf-8')
+
+def test_6():
+    # Messages and exit status do not depend on --jobs.
+    yield validate_jobs_messages, '', False
+    yield validate_jobs_messages, '--verbose', False
+
+    # A file named twice gets recoded twice.
+    yield validate_jobs_messages, '--verbose', True
+
+def validate_jobs_messages(options, twice):
+    names = ['%s-%d' % (common.run.work, counter) for counter in range(6)]
+    arguments = names + ['%s/./%s' % os.path.split(names[5])] * twice
+    texts = [b'\303\251t\303\251\n', b'caf\351\n', b'plain\n',
+             b'\303\240 bient\303\264t\n', b'na\357f\n', b'\302\253\302\273\n']
+    results = []
+    try:
+        for jobs in (1, 3):
+            for name, text in zip(names, texts):
+                with open(name, 'wb') as f:
+                    f.write(text)
+            command = ('$R %s --jobs=%d utf-8..latin1 %s'
+                       % (options, jobs, ' '.join(arguments)))
+            print(command)
+            results.append(common.external_status(command))
+            outputs = []
+            for name in names:
+                with open(name, 'rb') as f:
+                    outputs.append(f.read())
+            results.append(outputs)
+        assert results[0][0] == 1
+        assert results[2] == results[0]
+        assert results[3] == results[1]
+    finally:
+        for name in names:
+            if os.path.exists(name):
+                os.remove(name)
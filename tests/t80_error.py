@@ -2,6 +2,8 @@
 import common
 from common import setup_module, teardown_module, Recode, outer, outer_iconv
 
+import os
+
 class Test:
 
     def test_1(self): # Ensure correct error code returned for untranslatable input
@@ -21,3 +23,64 @@ class Test:
         task.set_abort_level(Recode.UNTRANSLATABLE)
         task.perform()
         assert(task.get_error() == Recode.UNTRANSLATABLE)
+
+    def test_3(self): # Ensure a reset task forgets errors but keeps working
+        request = Recode.Request(outer)
+        request.scan(b'utf-8..ibmpc')
+        task = Recode.Task(request)
+        task.set_input(b"\303\241 \316\261")
+        task.perform()
+        assert(task.get_error() == Recode.UNTRANSLATABLE)
+        for counter in range(3):
+            task.reset()
+            assert(task.get_error() == Recode.NO_ERROR)
+            task.set_input(b"\303\251t\303\251")
+            assert(task.perform())
+            assert(task.get_output() == b"\202t\202")
+
+    def test_4(self): # Ensure errors in a batch are reported for each text
+        request = Recode.Request(outer)
+        request.scan(b'utf-8..ibmpc')
+        texts = [b"\303\251t\303\251", b"", b"\303\241 \316\261", b"abc"]
+        results = request.batch(texts)
+        assert(len(results) == len(texts))
+        for counter in (0, 1, 3):
+            assert(results[counter] == (request.string(texts[counter]),
+                                        Recode.NO_ERROR))
+        assert(results[2][1] == Recode.UNTRANSLATABLE)
+
+    def test_5(self): # Ensure reused iconv descriptors start afresh
+        request = Recode.Request(outer_iconv)
+        request.scan(b'utf-8..latin1')
+        task = Recode.Task(request)
+        task.set_input(b"\303\241 \316\261")
+        task.set_abort_level(Recode.UNTRANSLATABLE)
+        task.perform()
+        assert(task.get_error() == Recode.UNTRANSLATABLE)
+        for counter in range(3):
+            assert(request.string(b"\303\251t\303\251") == b"\351t\351")
+        request = Recode.Request(outer_iconv)
+        request.scan(b'utf-8..iso-2022-jp')
+        first = request.string(b"a\343\201\202")
+        for counter in range(3):
+            assert(request.string(b"a\343\201\202") == first)
+
+    def test_6(self): # Ensure a failing file does not fail later files
+        names = ['%s-%d' % (common.run.work, counter) for counter in range(3)]
+        texts = [b"\303\251t\303\251", b"caf\351", b"\303\251t\303\251"]
+        try:
+            for name, text in zip(names, texts):
+                with open(name, 'wb') as f:
+                    f.write(text)
+            status, errors = common.external_status(
+                    '$R utf-8..latin1 %s' % ' '.join(names))
+            assert status == 1
+            assert errors.count(' failed: ') == 1
+            assert os.path.realpath(names[1]) + ' failed: ' in errors
+            for counter in (0, 2):
+                with open(names[counter], 'rb') as f:
+                    assert f.read() == b"\351t\351"
+        finally:
+            for name in names:
+                if os.path.exists(name):
+                    os.remove(name)
@@ -0,0 +1,272 @@
+/* Stress checking of Recode requests shared between threads.
+   Copyright © 2026 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Each request below is scanned once, then performed once over its input
+   for getting a reference outcome.  Many threads then perform all these
+   requests again and again, each thread through tasks of its own, while
+   sharing the requests and their outer.  Every outcome should agree with
+   the reference one.  Requests are chosen to cover steps keeping some
+   state while recoding: Flex scanners, charnames, counting, and iconv
+   descriptors when iconv is available.  Options are:
+
+     -n COUNT   Have each thread perform all requests COUNT times,
+		instead of 50.
+     -t COUNT   Start COUNT threads, instead of 8.  */
+
+#include "config.h"
+#include "common.h"
+
+#include <unistd.h>
+
+#include "glthread/thread.h"
+
+const char *program_name = "threads";
+
+/* Requests to check, each with a sample of input, and whether iconv is
+   needed.  The sample gets repeated into a longer input.  */
+
+struct sample
+  {
+    const char *request;	/* request to scan */
+    const char *text;		/* sample of input */
+    bool iconv;			/* if the request goes through iconv */
+  };
+
+static const struct sample samples[] =
+  {
+    { "Latin-1..UTF-8", "\351t\351 \340 Qu\351bec, \253na\357f\273.\n",
+      false },
+    { "UTF-8..Latin-1/CR-LF", "\303\251t\303\251 \303\240 Qu\303\251bec.\n",
+      false },
+    { "Texte..Latin-1", "L'e'te' a` Que'bec, c\"ur na\"if.\n", false },
+    { "LaTeX..Latin-1", "\\'et\\'e \\`a Qu\\'ebec, na\\\"\\i f.\n", false },
+    { "HTML..UTF-8", "&eacute;t&eacute; &agrave; &lt;Qu&#233;bec&gt;\n",
+      false },
+    { "UTF-8..HTML", "\303\251t\303\251 <\303\240> & \316\261\n", false },
+    { "UTF-8..RFC1345", "\303\251t\303\251 \316\261\316\262 \342\202\254\n",
+      false },
+    { "Latin-1..dump-with-names", "\351t\351 \340\n", false },
+    { "UTF-8..count-characters", "\303\251t\303\251 \316\261\316\262\n",
+      false },
+    { "Latin-1..UTF-8/Base64", "\351t\351 \340 Qu\351bec.\n", false },
+    { "UTF-8..ISO-2022-JP", "a\343\201\202b\346\274\242c\n", true },
+    { "UTF-8..KOI8-R", "\320\277\321\200\320\270\320\262\320\265\321\202\n",
+      true },
+  };
+
+#define NUMBER_OF_SAMPLES (sizeof samples / sizeof samples[0])
+
+/* How many times a sample gets repeated into an input.  */
+#define REPEAT_COUNT 200
+
+static RECODE_OUTER outer;
+static RECODE_OUTER iconv_outer;
+
+/* Everything known about each request, once prepared.  */
+
+struct check
+  {
+    RECODE_REQUEST request;	/* scanned request, or NULL to skip */
+    char *input;		/* input text */
+    size_t input_length;	/* length of input text */
+    char *output;		/* reference output text */
+    size_t output_length;	/* length of reference output text */
+    enum recode_error error;	/* reference error level */
+  };
+
+static struct check checks[NUMBER_OF_SAMPLES];
+
+/* Recode the input of CHECK through its request, in a new task.  Return
+   the task once performed, which the caller should delete.  */
+
+static RECODE_TASK
+perform (const struct check *check)
+{
+  RECODE_TASK task = recode_new_task (check->request);
+
+  if (!task)
+    abort ();
+  task->input.buffer = check->input;
+  task->input.cursor = check->input;
+  task->input.limit = check->input + check->input_length;
+  recode_perform_task (task);
+  return task;
+}
+
+/* Scan all requests, and get their reference outcomes.  */
+
+static void
+prepare (void)
+{
+  unsigned index;
+
+  outer = recode_new_outer (RECODE_NO_ICONV_FLAG);
+  iconv_outer = recode_new_outer (0);
+  if (!outer || !iconv_outer)
+    abort ();
+
+  for (index = 0; index < NUMBER_OF_SAMPLES; index++)
+    {
+      const struct sample *sample = samples + index;
+      struct check *check = checks + index;
+      size_t length = strlen (sample->text);
+      RECODE_TASK task;
+      unsigned counter;
+
+      check->request
+	= recode_new_request (sample->iconv ? iconv_outer : outer);
+      if (!check->request)
+	abort ();
+      if (!recode_scan_request (check->request, sample->request))
+	{
+	  /* The iconv library may not know some charsets.  */
+
+	  if (sample->iconv)
+	    {
+	      recode_delete_request (check->request);
+	      check->request = NULL;
+	      continue;
+	    }
+	  fprintf (stderr, "%s: cannot scan request `%s'\n",
+		   program_name, sample->request);
+	  exit (EXIT_FAILURE);
+	}
+
+      check->input_length = REPEAT_COUNT * length;
+      check->input = malloc (check->input_length);
+      if (!check->input)
+	abort ();
+      for (counter = 0; counter < REPEAT_COUNT; counter++)
+	memcpy (check->input + counter * length, sample->text, length);
+
+      task = perform (check);
+      check->output = task->output.buffer;
+      check->output_length = task->output.cursor - task->output.buffer;
+      check->error = task->error_so_far;
+      recode_delete_task (task);
+    }
+}
+
+/* What each thread should do, and what it found.  */
+
+struct worker
+  {
+    unsigned rounds;		/* how many times to perform all requests */
+    unsigned offset;		/* first request to perform in each round */
+    unsigned failures;		/* number of disagreements met */
+  };
+
+/* Perform all requests many times, each time in a new task, starting
+   at a different request in each thread.  Count disagreements.  */
+
+static void *
+work (void *void_worker)
+{
+  struct worker *worker = (struct worker *) void_worker;
+  unsigned round;
+  unsigned counter;
+
+  for (round = 0; round < worker->rounds; round++)
+    for (counter = 0; counter < NUMBER_OF_SAMPLES; counter++)
+      {
+	unsigned index = (worker->offset + counter) % NUMBER_OF_SAMPLES;
+	const struct check *check = checks + index;
+	RECODE_TASK task;
+	size_t length;
+
+	if (!check->request)
+	  continue;
+
+	task = perform (check);
+	length = task->output.cursor - task->output.buffer;
+	if (length != check->output_length
+	    || memcmp (task->output.buffer, check->output, length) != 0
+	    || task->error_so_far != check->error)
+	  worker->failures++;
+	recode_free (check->request->outer, task->output.buffer);
+	recode_delete_task (task);
+      }
+
+  return NULL;
+}
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned rounds = 50;
+  unsigned thread_count = 8;
+  struct worker *workers;
+  gl_thread_t *threads;
+  unsigned failures = 0;
+  unsigned index;
+  int option_char;
+
+  while (option_char = getopt (argc, argv, "n:t:"), option_char != EOF)
+    switch (option_char)
+      {
+      case 'n':
+	rounds = atoi (optarg);
+	break;
+
+      case 't':
+	thread_count = atoi (optarg);
+	break;
+
+      default:
+	fprintf (stderr, "Usage: %s [-n COUNT] [-t COUNT]\n", program_name);
+	return EXIT_FAILURE;
+      }
+
+  prepare ();
+
+  workers = calloc (thread_count, sizeof (struct worker));
+  threads = calloc (thread_count, sizeof (gl_thread_t));
+  if (!workers || !threads)
+    abort ();
+
+  for (index = 0; index < thread_count; index++)
+    {
+      workers[index].rounds = rounds;
+      workers[index].offset = index;
+      threads[index] = gl_thread_create (work, workers + index);
+    }
+  for (index = 0; index < thread_count; index++)
+    {
+      gl_thread_join (threads[index], NULL);
+      failures += workers[index].failures;
+    }
+
+  for (index = 0; index < NUMBER_OF_SAMPLES; index++)
+    if (checks[index].request)
+      {
+	recode_free (checks[index].request->outer, checks[index].output);
+	recode_delete_request (checks[index].request);
+	free (checks[index].input);
+      }
+    else
+      fprintf (stderr, "%s: `%s' skipped\n", program_name,
+	       samples[index].request);
+
+  free (workers);
+  free (threads);
+  recode_delete_outer (outer);
+  recode_delete_outer (iconv_outer);
+
+  if (failures)
+    fprintf (stderr, "%s: %u disagreements\n", program_name, failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}